@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/eval_env.h"
+#include "../src/gc.h"
+#include "../src/reader.h"
+#include "../src/value.h"
+#include "../src/vm.h"
+#include "./workloads.h"
+
+struct Result {
+    std::string name;
+    double mean = 0;
+    double median = 0;
+    double p99 = 0;
+    double min = 0;
+    double max = 0;
+    double allocations = 0;
+};
+
+ValuePtr parse(const std::string& source) {
+    return Reader(source).read().value();
+}
+
+// Every run gets fresh global state, so no run sees definitions or garbage
+// of the one before it. Only the evaluation of workload.run is timed.
+Result runWorkload(const Workload& workload, bool vm, int warmup, int runs) {
+    std::vector<ValuePtr> setup;
+    for (const auto& form : workload.setup) {
+        setup.push_back(parse(form));
+    }
+    ValuePtr expr = parse(workload.run);
+
+    std::vector<double> times;
+    size_t allocations = 0;
+    for (int i = 0; i < warmup + runs; i++) {
+        auto env = std::make_shared<EvalEnv>();
+        VM machine(*env);
+        auto evaluate = [&](const ValuePtr& value) {
+            return vm ? machine.eval(value) : env->eval(value);
+        };
+        for (const auto& form : setup) {
+            evaluate(form);
+        }
+
+        size_t allocationsBefore = Collector::totalAllocations();
+        auto start = std::chrono::steady_clock::now();
+        ValuePtr result = evaluate(expr);
+        auto end = std::chrono::steady_clock::now();
+        size_t allocated = Collector::totalAllocations() - allocationsBefore;
+
+        if (result->toString() != workload.expected) {
+            throw std::runtime_error(workload.name + " returned " + result->toString() +
+                                     ", expected " + workload.expected);
+        }
+        if (i >= warmup) {
+            times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+            allocations = allocated;
+        }
+        result = nullptr;
+        env = nullptr;
+        Collector::collect();
+    }
+
+    std::sort(times.begin(), times.end());
+    Result result;
+    result.name = workload.name;
+    for (auto time : times) {
+        result.mean += time / times.size();
+    }
+    size_t middle = times.size() / 2;
+    result.median = times.size() % 2 ? times[middle] : (times[middle - 1] + times[middle]) / 2;
+    result.p99 = times[static_cast<size_t>(std::ceil(times.size() * 0.99)) - 1];
+    result.min = times.front();
+    result.max = times.back();
+    result.allocations = static_cast<double>(allocations);
+    return result;
+}
+
+void writeJson(std::ostream& out, const std::string& engine, int warmup, int runs,
+               const std::vector<Result>& results) {
+    out << std::fixed << std::setprecision(4);
+    out << "{\n";
+    out << "  \"engine\": \"" << engine << "\",\n";
+    out << "  \"warmup\": " << warmup << ",\n";
+    out << "  \"runs\": " << runs << ",\n";
+    out << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"mean_ms\": " << r.mean
+            << ", \"median_ms\": " << r.median << ", \"p99_ms\": " << r.p99
+            << ", \"min_ms\": " << r.min << ", \"max_ms\": " << r.max
+            << ", \"allocations\": " << std::setprecision(0) << r.allocations << std::setprecision(4)
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+
+/**JsonReader class
+ * Reads back the files written by writeJson: just enough JSON to walk
+ * objects, arrays, strings and numbers.
+ */
+class JsonReader {
+    std::string text;
+    size_t pos = 0;
+
+    void skipSpace() {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+            pos++;
+        }
+    }
+
+    void expect(char c) {
+        skipSpace();
+        if (pos >= text.size() || text[pos] != c) {
+            throw std::runtime_error(std::string("Malformed result file: expected '") + c + "'");
+        }
+        pos++;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (pos < text.size() && text[pos] == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    std::string readString() {
+        expect('"');
+        std::string result;
+        while (pos < text.size() && text[pos] != '"') {
+            if (text[pos] == '\\' && pos + 1 < text.size()) {
+                pos++;
+            }
+            result += text[pos++];
+        }
+        expect('"');
+        return result;
+    }
+
+    // Skips a value that is of no interest; returns it if it is a number.
+    double readScalar() {
+        skipSpace();
+        if (pos < text.size() && text[pos] == '"') {
+            readString();
+            return 0;
+        }
+        size_t end = pos;
+        while (end < text.size() && std::string(",}] \t\r\n").find(text[end]) == std::string::npos) {
+            end++;
+        }
+        std::string token = text.substr(pos, end - pos);
+        pos = end;
+        try {
+            return std::stod(token);
+        } catch (std::exception&) {
+            return 0;
+        }
+    }
+
+    void skipValue() {
+        skipSpace();
+        if (consume('{')) {
+            if (!consume('}')) {
+                do {
+                    readString();
+                    expect(':');
+                    skipValue();
+                } while (consume(','));
+                expect('}');
+            }
+        } else if (consume('[')) {
+            if (!consume(']')) {
+                do {
+                    skipValue();
+                } while (consume(','));
+                expect(']');
+            }
+        } else {
+            readScalar();
+        }
+    }
+
+    Result readResult() {
+        Result result;
+        expect('{');
+        if (consume('}')) {
+            return result;
+        }
+        do {
+            std::string key = readString();
+            expect(':');
+            if (key == "name") {
+                result.name = readString();
+            } else if (key == "mean_ms") {
+                result.mean = readScalar();
+            } else if (key == "median_ms") {
+                result.median = readScalar();
+            } else if (key == "p99_ms") {
+                result.p99 = readScalar();
+            } else if (key == "min_ms") {
+                result.min = readScalar();
+            } else if (key == "max_ms") {
+                result.max = readScalar();
+            } else if (key == "allocations") {
+                result.allocations = readScalar();
+            } else {
+                skipValue();
+            }
+        } while (consume(','));
+        expect('}');
+        return result;
+    }
+
+public:
+    JsonReader(std::string text) : text{std::move(text)} {}
+
+    std::vector<Result> readResults() {
+        std::vector<Result> results;
+        expect('{');
+        do {
+            std::string key = readString();
+            expect(':');
+            if (key != "benchmarks") {
+                skipValue();
+                continue;
+            }
+            expect('[');
+            if (!consume(']')) {
+                do {
+                    results.push_back(readResult());
+                } while (consume(','));
+                expect(']');
+            }
+        } while (consume(','));
+        expect('}');
+        return results;
+    }
+};
+
+std::vector<Result> readResultFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Could not open file " + path);
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return JsonReader(buffer.str()).readResults();
+}
+
+// A benchmark regresses when its median time or the number of objects it
+// allocates grows by more than threshold percent. A few more objects are
+// allowed on top, as engines allocate some per run whatever the workload.
+constexpr double ALLOCATION_SLACK = 16;
+
+int compare(const std::string& basePath, const std::string& newPath, double threshold) {
+    auto base = readResultFile(basePath);
+    auto current = readResultFile(newPath);
+    std::map<std::string, Result> baseByName;
+    for (const auto& result : base) {
+        baseByName[result.name] = result;
+    }
+
+    int regressions = 0;
+    std::cout << std::left << std::setw(12) << "benchmark" << std::right << std::setw(12) << "base ms"
+              << std::setw(12) << "new ms" << std::setw(10) << "change" << std::setw(14) << "base allocs"
+              << std::setw(14) << "new allocs" << std::endl;
+    for (const auto& result : current) {
+        auto found = baseByName.find(result.name);
+        if (found == baseByName.end()) {
+            std::cout << std::left << std::setw(12) << result.name << "  (not in " << basePath << ")" << std::endl;
+            continue;
+        }
+        const auto& old = found->second;
+        double change = old.median > 0 ? (result.median - old.median) / old.median * 100 : 0;
+        std::string verdict;
+        if (change > threshold) {
+            verdict = "REGRESSION";
+        } else if (result.allocations > old.allocations * (1 + threshold / 100) + ALLOCATION_SLACK) {
+            verdict = "REGRESSION (allocations)";
+        } else if (change < -threshold) {
+            verdict = "improved";
+        }
+        if (verdict.starts_with("REGRESSION")) {
+            regressions++;
+        }
+        std::cout << std::left << std::setw(12) << result.name << std::right << std::fixed
+                  << std::setprecision(3) << std::setw(12) << old.median << std::setw(12) << result.median
+                  << std::setprecision(1) << std::setw(9) << std::showpos << change << "%" << std::noshowpos
+                  << std::setprecision(0) << std::setw(14) << old.allocations << std::setw(14)
+                  << result.allocations << "  " << verdict << std::endl;
+    }
+    if (regressions > 0) {
+        std::cout << regressions << " regression(s) above " << threshold << "%" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+void usage() {
+    std::cerr << "Usage: mini_lisp_bench [--engine=tree|vm] [--warmup=N] [--runs=N] [--output=FILE] [NAME...]\n"
+              << "       mini_lisp_bench --compare BASE.json NEW.json [--threshold=PERCENT]\n"
+              << "Benchmarks:";
+    for (const auto& workload : WORKLOADS) {
+        std::cerr << " " << workload.name;
+    }
+    std::cerr << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    std::string engine = "tree";
+    std::string output;
+    int warmup = 2;
+    int runs = 10;
+    double threshold = 5;
+    std::vector<std::string> names;
+    bool comparing = false;
+
+    try {
+        for (const auto& arg : args) {
+            if (arg.starts_with("--engine=")) {
+                engine = arg.substr(std::string("--engine=").size());
+            } else if (arg.starts_with("--warmup=")) {
+                warmup = std::stoi(arg.substr(std::string("--warmup=").size()));
+            } else if (arg.starts_with("--runs=")) {
+                runs = std::stoi(arg.substr(std::string("--runs=").size()));
+            } else if (arg.starts_with("--output=")) {
+                output = arg.substr(std::string("--output=").size());
+            } else if (arg.starts_with("--threshold=")) {
+                threshold = std::stod(arg.substr(std::string("--threshold=").size()));
+            } else if (arg == "--compare") {
+                comparing = true;
+            } else if (arg.starts_with("-")) {
+                usage();
+                return 2;
+            } else {
+                names.push_back(arg);
+            }
+        }
+    } catch (std::exception&) {
+        usage();
+        return 2;
+    }
+
+    try {
+        if (comparing) {
+            if (names.size() != 2) {
+                usage();
+                return 2;
+            }
+            return compare(names[0], names[1], threshold);
+        }
+        if ((engine != "tree" && engine != "vm") || warmup < 0 || runs < 1) {
+            usage();
+            return 2;
+        }
+
+        std::vector<Result> results;
+        for (const auto& workload : WORKLOADS) {
+            if (!names.empty() && std::find(names.begin(), names.end(), workload.name) == names.end()) {
+                continue;
+            }
+            std::cerr << workload.name << "..." << std::flush;
+            results.push_back(runWorkload(workload, engine == "vm", warmup, runs));
+            std::cerr << " median " << std::fixed << std::setprecision(3) << results.back().median << " ms"
+                      << std::endl;
+        }
+
+        if (output.empty()) {
+            writeJson(std::cout, engine, warmup, runs, results);
+        } else {
+            std::ofstream file(output);
+            if (!file) {
+                throw std::runtime_error("Could not open file " + output);
+            }
+            writeJson(file, engine, warmup, runs, results);
+        }
+    } catch (std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
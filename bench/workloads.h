@@ -0,0 +1,111 @@
+#ifndef WORKLOADS_H
+#define WORKLOADS_H
+
+#include <string>
+#include <vector>
+
+/**Workload struct
+ * One benchmark: forms evaluated once per run without being timed, the
+ * expression whose evaluation is timed, and the printed result it must
+ * produce, so a broken interpreter cannot pass for a fast one.
+ */
+struct Workload {
+    std::string name;
+    std::vector<std::string> setup;
+    std::string run;
+    std::string expected;
+};
+
+inline const std::vector<Workload> WORKLOADS = {
+    {
+        "fib",
+        {R"((define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))"},
+        "(fib 22)",
+        "17711",
+    },
+    {
+        "tak",
+        {R"((define (tak x y z)
+               (if (not (< y x))
+                   z
+                   (tak (tak (- x 1) y z) (tak (- y 1) z x) (tak (- z 1) x y)))))"},
+        "(tak 18 12 6)",
+        "7",
+    },
+    {
+        "ackermann",
+        {R"((define (ack m n)
+               (cond ((= m 0) (+ n 1))
+                     ((= n 0) (ack (- m 1) 1))
+                     (else (ack (- m 1) (ack m (- n 1)))))))"},
+        "(ack 3 6)",
+        "509",
+    },
+    {
+        "queens",
+        {R"((define (safe? row dist placed)
+               (if (null? placed)
+                   #t
+                   (let ((q (car placed)))
+                     (and (not (= q row))
+                          (not (= q (+ row dist)))
+                          (not (= q (- row dist)))
+                          (safe? row (+ dist 1) (cdr placed)))))))",
+         R"((define (count-rows row placed n)
+               (if (> row n)
+                   0
+                   (+ (if (safe? row 1 placed) (queens (cons row placed) n) 0)
+                      (count-rows (+ row 1) placed n)))))",
+         R"((define (queens placed n)
+               (if (= (length placed) n) 1 (count-rows 1 placed n))))"},
+        "(queens '() 8)",
+        "92",
+    },
+    {
+        // Tail-recursive map/filter/fold written in Lisp, so the time goes to
+        // calls and conses; the builtins of the same name walk the list with
+        // a ListView and cons the result in place with a ListBuilder.
+        "lists",
+        {R"((define (iota n)
+               (define (loop i acc) (if (= i 0) acc (loop (- i 1) (cons i acc))))
+               (loop n '())))",
+         R"((define (rev lst acc) (if (null? lst) acc (rev (cdr lst) (cons (car lst) acc)))))",
+         R"((define (lmap f lst)
+               (define (loop l acc) (if (null? l) (rev acc '()) (loop (cdr l) (cons (f (car l)) acc))))
+               (loop lst '())))",
+         R"((define (lfilter pred lst)
+               (define (loop l acc)
+                 (cond ((null? l) (rev acc '()))
+                       ((pred (car l)) (loop (cdr l) (cons (car l) acc)))
+                       (else (loop (cdr l) acc))))
+               (loop lst '())))",
+         R"((define (lfold f acc lst) (if (null? lst) acc (lfold f (f acc (car lst)) (cdr lst)))))"},
+        "(lfold + 0 (lfilter even? (lmap (lambda (x) (modulo x 7)) (iota 100000))))",
+        "171426",
+    },
+    {
+        "strings",
+        {R"((define (build i acc)
+               (if (= i 0) acc (build (- i 1) (string-append acc (number->string i) ",")))))"},
+        "(string-length (build 5000 \"\"))",
+        "23893",
+    },
+    {
+        "closures",
+        {R"((define (make-chain n)
+               (if (= n 0)
+                   (lambda (x) x)
+                   (let ((next (make-chain (- n 1))))
+                     (lambda (x) (+ 1 (next x)))))))",
+         R"((define (curry5 a) (lambda (b) (lambda (c) (lambda (d) (lambda (e) (+ a b c d e)))))))",
+         R"((define (closures k)
+               (let ((chain (make-chain 100)))
+                 (define (loop k acc)
+                   (if (= k 0) acc (loop (- k 1) (+ acc (chain 0) (((((curry5 k) 1) 2) 3) 4)))))
+                 (loop k 0))))"},
+        "(closures 2000)",
+        "2221000",
+    },
+};
+
+#endif
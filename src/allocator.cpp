@@ -0,0 +1,114 @@
+#include <cstdint>
+#include <new>
+
+#include "./allocator.h"
+
+namespace {
+
+constexpr size_t GRANULE = 16;
+constexpr size_t SLAB_SIZE = 64 * 1024;
+
+struct Block {
+    Block* next;
+};
+
+// Every slab starts with this header and is aligned to its own size, so
+// a block finds the slab it belongs to by masking its address.
+struct Slab {
+    Block* freeList = nullptr;
+    Slab* nextAvailable = nullptr;
+    // Whether the slab is its pool's current slab or on its available list.
+    bool listed = false;
+};
+
+constexpr size_t HEADER_SIZE = (sizeof(Slab) + GRANULE - 1) / GRANULE * GRANULE;
+
+/**Pool class
+ * Blocks of one size. Each slab keeps its own free blocks, and the pool
+ * allocates from one slab until it is full before it moves on to another
+ * with free blocks. Objects allocated together so share a few slabs even
+ * when they reuse blocks freed in between, as when a list is consed while
+ * another is dropped cell by cell.
+ */
+class Pool {
+    size_t blockSize = 0;
+    Slab* current = nullptr;
+    Slab* available = nullptr;
+
+    Slab* newSlab() {
+        auto slab = new (::operator new(SLAB_SIZE, std::align_val_t{SLAB_SIZE})) Slab;
+        auto base = reinterpret_cast<std::byte*>(slab);
+        size_t count = (SLAB_SIZE - HEADER_SIZE) / blockSize;
+        for (size_t i = count; i-- > 0;) {
+            auto block = reinterpret_cast<Block*>(base + HEADER_SIZE + i * blockSize);
+            block->next = slab->freeList;
+            slab->freeList = block;
+        }
+        return slab;
+    }
+
+public:
+    void setBlockSize(size_t size) {
+        blockSize = size;
+    }
+
+    void* allocate() {
+        if (current == nullptr || current->freeList == nullptr) {
+            if (current != nullptr) {
+                current->listed = false;
+            }
+            if (available != nullptr) {
+                current = available;
+                available = available->nextAvailable;
+            } else {
+                current = newSlab();
+            }
+            current->listed = true;
+        }
+        Block* block = current->freeList;
+        current->freeList = block->next;
+        return block;
+    }
+
+    void deallocate(void* pointer) {
+        auto slab = reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(pointer) & ~(SLAB_SIZE - 1));
+        auto block = static_cast<Block*>(pointer);
+        block->next = slab->freeList;
+        slab->freeList = block;
+        if (!slab->listed) {
+            slab->listed = true;
+            slab->nextAvailable = available;
+            available = slab;
+        }
+    }
+};
+
+// Never destroyed: values owned by other static objects are released
+// during static destruction, possibly after this function's statics.
+Pool* pools() {
+    static Pool* pools = [] {
+        auto result = new Pool[SLAB_MAX_SIZE / GRANULE];
+        for (size_t i = 0; i < SLAB_MAX_SIZE / GRANULE; i++) {
+            result[i].setBlockSize((i + 1) * GRANULE);
+        }
+        return result;
+    }();
+    return pools;
+}
+
+}
+
+void* slabAllocate(size_t size) {
+    if (size == 0 || size > SLAB_MAX_SIZE) {
+        return ::operator new(size);
+    }
+    return pools()[(size - 1) / GRANULE].allocate();
+}
+
+void slabDeallocate(void* pointer, size_t size) {
+    if (size == 0 || size > SLAB_MAX_SIZE) {
+        ::operator delete(pointer);
+        return;
+    }
+    pools()[(size - 1) / GRANULE].deallocate(pointer);
+}
@@ -0,0 +1,43 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+
+/**Slab allocator
+ * Small objects of the interpreter (cons cells, closures, frames) are
+ * taken from 64 KiB slabs of blocks of one size, instead of one malloc
+ * each. Sizes are rounded up to 16 bytes; anything above SLAB_MAX_SIZE
+ * goes to the global heap. Each slab keeps its freed blocks for reuse, and
+ * allocation fills one slab before the next, so neighbouring allocations
+ * stay close. Slabs are never returned.
+ */
+constexpr size_t SLAB_MAX_SIZE = 256;
+
+void* slabAllocate(size_t size);
+void slabDeallocate(void* pointer, size_t size);
+
+// Standard allocator over the slabs, for std::allocate_shared.
+template <typename T>
+class SlabAllocator {
+public:
+    using value_type = T;
+
+    SlabAllocator() = default;
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(slabAllocate(n * sizeof(T)));
+    }
+    void deallocate(T* pointer, size_t n) {
+        slabDeallocate(pointer, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const SlabAllocator<U>&) const {
+        return true;
+    }
+};
+
+#endif
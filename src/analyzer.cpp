@@ -0,0 +1,302 @@
+#include <algorithm>
+
+#include "./analyzer.h"
+#include "./error.h"
+#include "./forms.h"
+
+bool isSelfEvaluating(const ValuePtr& expr) {
+    return expr->isType(ValueType::BOOLEAN) ||
+           expr->isType(ValueType::NUMERIC) ||
+           expr->isType(ValueType::STRING);
+}
+
+// Scopes are searched up to the innermost lambda scope, which has no
+// parent; past it, a local variable can only be one of its captures.
+std::optional<LocalBinding> resolveLocal(Symbol name, const ScopePtr& scope) {
+    size_t depth = 0;
+    for (auto frame = scope.get(); frame != nullptr; frame = frame->parent.get(), depth++) {
+        if (auto slot = frame->find(name)) {
+            return LocalBinding{false, depth, *slot, frame->isBoxed(*slot)};
+        }
+        if (auto index = frame->findCapture(name)) {
+            return LocalBinding{true, depth, *index, frame->captures[*index].boxed};
+        }
+    }
+    return std::nullopt;
+}
+
+NodePtr analyzeVariable(Symbol name, const ScopePtr& scope) {
+    if (auto binding = resolveLocal(name, scope)) {
+        if (binding->captured) {
+            return std::make_shared<CapturedVariableNode>(name, *binding);
+        }
+        return std::make_shared<LocalVariableNode>(name, *binding);
+    }
+    return std::make_shared<GlobalVariableNode>(name);
+}
+
+NodePtr analyze(const ValuePtr& expr, const ScopePtr& scope) {
+    if (isSelfEvaluating(expr)) {
+
+        return std::make_shared<ConstantNode>(expr);
+
+    } else if (expr->isType(ValueType::NIL)) {
+
+        throw LispError("Evaluating nil is prohibited.");
+
+    } else if (expr->isType(ValueType::SYMBOL)) {
+
+        return analyzeVariable(expr->asSymbol().value(), scope);
+
+    } else if (expr->isType(ValueType::PAIR)) {
+
+        auto pairExpr = static_cast<PairValue*>(expr.get());
+        auto head = pairExpr->getCar();
+
+        if (head->isType(ValueType::SYMBOL)) {
+            if (auto specialForm = SPECIAL_FORMS.find(head->asSymbol().value()); specialForm != SPECIAL_FORMS.end()) {
+                return (specialForm->second)(pairExpr->getCdr()->toVector(), scope);
+            }
+        } else if (!head->isType(ValueType::PAIR)) {
+            throw LispError("Unimplemented.");
+        }
+
+        return std::make_shared<CallNode>(
+            analyze(head, scope),
+            analyzeList(ListView(pairExpr->getCdr()), scope)
+        );
+
+    } else {
+        throw LispError("Unimplemented.");
+    }
+}
+
+std::vector<NodePtr> analyzeList(const std::vector<ValuePtr>& exprs, const ScopePtr& scope) {
+    std::vector<NodePtr> result;
+    result.reserve(exprs.size());
+    for (const auto& expr : exprs) {
+        result.push_back(analyze(expr, scope));
+    }
+    return result;
+}
+
+std::vector<NodePtr> analyzeList(ListView exprs, const ScopePtr& scope) {
+    std::vector<NodePtr> result;
+    auto it = exprs.begin();
+    for (; it != exprs.end(); ++it) {
+        result.push_back(analyze(*it, scope));
+    }
+    if (!it.rest()->isType(ValueType::NIL)) {
+        throw LispError("Malformed list of expressions.");
+    }
+    return result;
+}
+
+// Names bound by define forms that run in the scope of `expr`. Nested
+// lambdas and let bodies open scopes of their own and are not scanned.
+void collectDefines(const ValuePtr& expr, std::vector<Symbol>& names) {
+    if (!expr->isType(ValueType::PAIR)) {
+        return;
+    }
+    ListView elements(expr);
+    auto second = std::ranges::next(elements.begin());
+    if (auto head = (*elements.begin())->asSymbol()) {
+        if (*head == symbols::QUOTE || *head == symbols::QUASIQUOTE || *head == symbols::LAMBDA) {
+            return;
+        }
+        if (*head == symbols::LET) {
+            if (second != elements.end() && (*second)->isType(ValueType::PAIR)) {
+                for (const auto& binding : ListView(*second)) {
+                    ListView pair(binding);
+                    if (binding->isType(ValueType::PAIR) && pair.size() == 2) {
+                        collectDefines(*std::ranges::next(pair.begin()), names);
+                    }
+                }
+            }
+            return;
+        }
+        if (*head == symbols::DEFINE && second != elements.end()) {
+            const auto& target = *second;
+            if (target->isType(ValueType::PAIR)) {
+                names.push_back(Symbol::intern(static_cast<PairValue*>(target.get())->getCar()->toString()));
+                return;
+            }
+            if (auto name = target->asSymbol()) {
+                names.push_back(*name);
+            }
+        }
+    }
+    for (const auto& element : elements) {
+        collectDefines(element, names);
+    }
+}
+
+std::vector<Symbol> parameterNames(const ValuePtr& params) {
+    std::vector<Symbol> result;
+    std::ranges::transform(
+        ListView(params),
+        std::back_inserter(result),
+        [](ValuePtr v) { return Symbol::intern(v->toString()); }
+    );
+    return result;
+}
+
+namespace {
+
+/**FreeVariables class
+ * Walks forms the way analysis will, reporting each variable they refer
+ * to without binding it themselves, together with the number of lambdas
+ * around the reference within the walked forms. Malformed forms are
+ * walked as far as they go; analyzing them reports the error.
+ */
+template <typename Use>
+class FreeVariables {
+    Use use;
+    std::vector<Symbol> bound;
+    size_t lambdas = 0;
+
+    void lambda(const ValuePtr& params, const ValuePtr& exprs) {
+        lambdas++;
+        body(parameterNames(params), ListView(exprs));
+        lambdas--;
+    }
+
+    void quasiquote(const ValuePtr& arg) {
+        if (!arg->isType(ValueType::PAIR)) {
+            return;
+        }
+        auto pair = static_cast<PairValue*>(arg.get());
+        if (auto symbol = pair->getCar()->asSymbol(); symbol == symbols::UNQUOTE || symbol == symbols::UNQUOTE_COMMA) {
+            for (const auto& operand : ListView(pair->getCdr())) {
+                form(operand);
+            }
+            return;
+        }
+        quasiquote(pair->getCar());
+        quasiquote(pair->getCdr());
+    }
+
+public:
+    FreeVariables(Use use) : use{use} {}
+
+    // A body that binds names and the defines in it.
+    template <typename Exprs>
+    void body(std::vector<Symbol> names, const Exprs& exprs) {
+        for (const auto& expr : exprs) {
+            collectDefines(expr, names);
+        }
+        size_t outer = bound.size();
+        bound.insert(bound.end(), names.begin(), names.end());
+        for (const auto& expr : exprs) {
+            form(expr);
+        }
+        bound.erase(bound.begin() + outer, bound.end());
+    }
+
+    void form(const ValuePtr& expr) {
+        if (auto name = expr->asSymbol()) {
+            if (std::ranges::find(bound, *name) == bound.end()) {
+                use(*name, lambdas);
+            }
+            return;
+        }
+        if (!expr->isType(ValueType::PAIR)) {
+            return;
+        }
+        auto pair = static_cast<PairValue*>(expr.get());
+        auto head = pair->getCar()->asSymbol();
+        if (!head || !SPECIAL_FORMS.contains(*head)) {
+            for (const auto& element : ListView(expr)) {
+                form(element);
+            }
+            return;
+        }
+
+        if (*head == symbols::QUOTE || !pair->getCdr()->isType(ValueType::PAIR)) {
+            return;
+        }
+        auto args = static_cast<PairValue*>(pair->getCdr().get());
+        const auto& first = args->getCar();
+        const auto& rest = args->getCdr();
+        if (*head == symbols::QUASIQUOTE) {
+            quasiquote(first);
+        } else if (*head == symbols::LAMBDA) {
+            lambda(first, rest);
+        } else if (*head == symbols::DEFINE) {
+            if (first->isType(ValueType::PAIR)) {
+                lambda(static_cast<PairValue*>(first.get())->getCdr(), rest);
+            } else {
+                for (const auto& value : ListView(rest)) {
+                    form(value);
+                }
+            }
+        } else if (*head == symbols::LET) {
+            std::vector<Symbol> names;
+            for (const auto& binding : ListView(first)) {
+                ListView parts(binding);
+                auto init = parts.begin();
+                if (init == parts.end()) {
+                    continue;
+                }
+                if (auto name = (*init)->asSymbol()) {
+                    names.push_back(*name);
+                }
+                for (++init; init != parts.end(); ++init) {
+                    form(*init);
+                }
+            }
+            body(std::move(names), ListView(rest));
+        } else {
+            for (const auto& arg : ListView(pair->getCdr())) {
+                form(arg);
+            }
+        }
+    }
+};
+
+}
+
+std::vector<Symbol> freeVariables(const std::vector<Symbol>& params, const std::vector<ValuePtr>& body) {
+    std::vector<Symbol> result;
+    FreeVariables walker([&result](Symbol name, size_t) {
+        if (std::ranges::find(result, name) == result.end()) {
+            result.push_back(name);
+        }
+    });
+    walker.body(params, body);
+    return result;
+}
+
+ScopePtr makeScope(const std::vector<Symbol>& params, const std::vector<ValuePtr>& body, const ScopePtr& parent,
+                   std::vector<Scope::Capture> captures) {
+    std::vector<Symbol> names = params;
+    for (const auto& expr : body) {
+        collectDefines(expr, names);
+    }
+    // A define of a parameter or of an earlier define reuses its slot.
+    std::vector<Symbol> slots{names.begin(), names.begin() + params.size()};
+    for (auto name = names.begin() + params.size(); name != names.end(); name++) {
+        if (std::ranges::find(slots, *name) == slots.end()) {
+            slots.push_back(*name);
+        }
+    }
+
+    // Only names the body both defines and captures in a lambda are boxed.
+    std::vector<Symbol> defined{names.begin() + params.size(), names.end()};
+    std::vector<Symbol> captured;
+    FreeVariables walker([&](Symbol name, size_t lambdas) {
+        if (lambdas > 0 && std::ranges::find(defined, name) != defined.end()) {
+            captured.push_back(name);
+        }
+    });
+    for (const auto& expr : body) {
+        walker.form(expr);
+    }
+    std::vector<size_t> boxes;
+    for (size_t i = 0; i < slots.size(); i++) {
+        if (std::ranges::find(captured, slots[i]) != captured.end()) {
+            boxes.push_back(i);
+        }
+    }
+    return std::make_shared<Scope>(slots, params.size(), parent, std::move(boxes), std::move(captures));
+}
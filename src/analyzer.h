@@ -0,0 +1,25 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include <optional>
+#include <vector>
+
+#include "./node.h"
+#include "./scope.h"
+#include "./value.h"
+
+NodePtr analyze(const ValuePtr& expr, const ScopePtr& scope);
+std::vector<NodePtr> analyzeList(const std::vector<ValuePtr>& exprs, const ScopePtr& scope);
+std::vector<NodePtr> analyzeList(ListView exprs, const ScopePtr& scope);
+
+std::optional<LocalBinding> resolveLocal(Symbol name, const ScopePtr& scope);
+
+std::vector<Symbol> parameterNames(const ValuePtr& params);
+void collectDefines(const ValuePtr& expr, std::vector<Symbol>& names);
+// Variables that the lambda (params body...) refers to and does not bind,
+// in order of first use.
+std::vector<Symbol> freeVariables(const std::vector<Symbol>& params, const std::vector<ValuePtr>& body);
+ScopePtr makeScope(const std::vector<Symbol>& params, const std::vector<ValuePtr>& body, const ScopePtr& parent,
+                   std::vector<Scope::Capture> captures = {});
+
+#endif
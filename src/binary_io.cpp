@@ -0,0 +1,74 @@
+#include "./binary_io.h"
+
+#include <cstring>
+#include <stdexcept>
+
+/**BinaryWriter class
+ * Methods of writing primitives
+ */
+void BinaryWriter::count(uint64_t value) {
+    while (value >= 0x80) {
+        byte(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    byte(static_cast<uint8_t>(value));
+}
+
+void BinaryWriter::bytes(std::string_view text) {
+    count(text.size());
+    out.write(text.data(), text.size());
+}
+
+void BinaryWriter::integer(int64_t value) {
+    count((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void BinaryWriter::real(double value) {
+    char raw[sizeof(double)];
+    std::memcpy(raw, &value, sizeof(double));
+    out.write(raw, sizeof(double));
+}
+
+
+/**BinaryReader class
+ * Methods of reading primitives
+ */
+uint8_t BinaryReader::byte() {
+    if (atEnd()) {
+        throw std::runtime_error("Truncated file");
+    }
+    return static_cast<uint8_t>(input[pos++]);
+}
+
+uint64_t BinaryReader::count() {
+    uint64_t result = 0;
+    for (int shift = 0;; shift += 7) {
+        if (shift > 63) {
+            throw std::runtime_error("Corrupt file");
+        }
+        uint8_t next = byte();
+        result |= static_cast<uint64_t>(next & 0x7f) << shift;
+        if (!(next & 0x80)) {
+            return result;
+        }
+    }
+}
+
+std::string_view BinaryReader::bytes(size_t length) {
+    if (length > input.size() - pos) {
+        throw std::runtime_error("Truncated file");
+    }
+    pos += length;
+    return input.substr(pos - length, length);
+}
+
+int64_t BinaryReader::integer() {
+    uint64_t zigzag = count();
+    return static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+}
+
+double BinaryReader::real() {
+    double value;
+    std::memcpy(&value, bytes(sizeof(double)).data(), sizeof(double));
+    return value;
+}
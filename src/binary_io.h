@@ -0,0 +1,61 @@
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+/**BinaryWriter and BinaryReader classes
+ * Primitives of the binary files the interpreter writes, fasl caches and
+ * images: single bytes, unsigned counts in a variable number of bytes,
+ * byte strings prefixed with their length, signed integers zigzag encoded
+ * like a count, and doubles raw in native byte order; these files stay on
+ * the machine that wrote them. Reading past the end throws std::runtime_error.
+ */
+class BinaryWriter {
+    std::ostream& out;
+
+public:
+    BinaryWriter(std::ostream& out) : out{out} {}
+
+    void byte(uint8_t value) {
+        out.put(static_cast<char>(value));
+    }
+    void count(uint64_t value);
+    void bytes(std::string_view text);
+    void integer(int64_t value);
+    void real(double value);
+};
+
+
+class BinaryReader {
+    std::string_view input;
+    size_t pos;
+
+public:
+    BinaryReader(std::string_view input, size_t pos = 0) : input{input}, pos{pos} {}
+
+    size_t position() const {
+        return pos;
+    }
+    bool atEnd() const {
+        return pos >= input.size();
+    }
+    void skipToEnd() {
+        pos = input.size();
+    }
+    uint8_t peek() const {
+        return atEnd() ? 0 : static_cast<uint8_t>(input[pos]);
+    }
+
+    uint8_t byte();
+    uint64_t count();
+    std::string_view bytes(size_t length);
+    std::string_view bytes() {
+        return bytes(count());
+    }
+    int64_t integer();
+    double real();
+};
+
+#endif
@@ -1,44 +1,53 @@
 #include <algorithm>
 #include <ranges>
 #include <iostream>
+#include <new>
 #include <unordered_map>
 #include <cmath>
 
 #include "./builtins.h"
 #include "./error.h"
 #include "./eval_env.h"
-#include "./parser.h"
-#include "./tokenizer.h"
-
-std::unordered_map<std::string, std::shared_ptr<BuiltinProcValue> > builtins::builtins;
-
-void builtins::init() {
-    builtins::builtins.insert(builtins::core_builtins.begin(), builtins::core_builtins.end());
-    builtins::builtins.insert(builtins::type_checking_builtins.begin(), builtins::type_checking_builtins.end());
-    builtins::builtins.insert(builtins::cons_list_builtins.begin(), builtins::cons_list_builtins.end());
-    builtins::builtins.insert(builtins::math_builtins.begin(), builtins::math_builtins.end());
-    builtins::builtins.insert(builtins::comparison_builtins.begin(), builtins::comparison_builtins.end());
+#include "./hash_table.h"
+#include "./image.h"
+#include "./number.h"
+#include "./reader.h"
+
+const std::unordered_map<Symbol, ValuePtr>& builtins::frame() {
+    static const auto frame = [] {
+        std::unordered_map<Symbol, ValuePtr> result;
+        for (const auto* library : {&core_builtins, &type_checking_builtins, &cons_list_builtins,
+                                    &vector_builtins, &hash_table_builtins, &math_builtins,
+                                    &comparison_builtins, &string_builtins}) {
+            for (const auto& [name, value] : *library) {
+                result.emplace(Symbol::intern(name), value);
+            }
+        }
+        return result;
+    }();
+    return frame;
 }
 
 
 // core library
 
-std::unordered_map<std::string, std::shared_ptr<BuiltinProcValue> > builtins::core_builtins = {
+std::unordered_map<std::string, ValuePtr> builtins::core_builtins = {
 
-    {"apply", std::make_shared<BuiltinProcValue>(&builtins::apply)},
-    {"display", std::make_shared<BuiltinProcValue>(&builtins::display)},
-    {"displayln", std::make_shared<BuiltinProcValue>(&builtins::displayln)},
-    {"error", std::make_shared<BuiltinProcValue>(&builtins::error)},
-    {"eval", std::make_shared<BuiltinProcValue>(&builtins::eval)},
-    {"exit", std::make_shared<BuiltinProcValue>(&builtins::exit)},
-    {"newline", std::make_shared<BuiltinProcValue>(&builtins::newline)},
-    {"print", std::make_shared<BuiltinProcValue>(&builtins::print)},
-    {"readline", std::make_shared<BuiltinProcValue>(&builtins::readline)},
-    {"help", std::make_shared<BuiltinProcValue>(&builtins::help)},
+    {"apply", makeValue<BuiltinProcValue>(&builtins::apply)},
+    {"display", makeValue<BuiltinProcValue>(&builtins::display)},
+    {"displayln", makeValue<BuiltinProcValue>(&builtins::displayln)},
+    {"error", makeValue<BuiltinProcValue>(&builtins::error)},
+    {"eval", makeValue<BuiltinProcValue>(&builtins::eval)},
+    {"exit", makeValue<BuiltinProcValue>(&builtins::exit)},
+    {"newline", makeValue<BuiltinProcValue>(&builtins::newline)},
+    {"print", makeValue<BuiltinProcValue>(&builtins::print)},
+    {"readline", makeValue<BuiltinProcValue>(&builtins::readline)},
+    {"help", makeValue<BuiltinProcValue>(&builtins::help)},
+    {"save-image", makeValue<BuiltinProcValue>(&builtins::saveImage)},
 
 };
 
-ValuePtr builtins::apply(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::apply(Arguments params, EvalEnv& env) {
     if (params.size() != 2) {
         throw LispError("Apply requires at least two arguments.");
     }
@@ -48,13 +57,13 @@ ValuePtr builtins::apply(const std::vector<ValuePtr>& params, EvalEnv& env) {
     ){
         throw LispError("Apply requires a procedure as its first argument.");
     }
-    if (!params[1]->isType(ValueType::PAIR)) {
+    if (!params[1]->isType(ValueType::PAIR) || !ListView(params[1]).isProper()) {
         throw LispError("Apply requires a list as its second argument.");
     }
     auto proc = params[0];
     std::vector<ValuePtr> args;
     std::ranges::transform(
-        params[1]->toVector(),
+        ListView(params[1]),
         std::back_inserter(args),
         [&env](ValuePtr v) { 
             if (v->isType(ValueType::PAIR)) {
@@ -67,7 +76,7 @@ ValuePtr builtins::apply(const std::vector<ValuePtr>& params, EvalEnv& env) {
     return proc->call(args, env);
 } 
 
-ValuePtr builtins::display(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::display(Arguments params, EvalEnv& env) {
     if (params.size() < 1) {
         throw LispError("Print requires more than one argument.");
     }
@@ -79,10 +88,10 @@ ValuePtr builtins::display(const std::vector<ValuePtr>& params, EvalEnv& env) {
             std::cout << i->toString();
         }
     }
-    return std::make_shared<NilValue>();
+    return ValuePtr::nil();
 }
 
-ValuePtr builtins::displayln(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::displayln(Arguments params, EvalEnv& env) {
     if (params.size() < 1) {
         throw LispError("Print requires more than one argument.");
     }
@@ -94,65 +103,68 @@ ValuePtr builtins::displayln(const std::vector<ValuePtr>& params, EvalEnv& env)
             std::cout << i->toString() << std::endl;
         }
     }
-    return std::make_shared<NilValue>();
+    return ValuePtr::nil();
 }
 
-ValuePtr builtins::error(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::error(Arguments params, EvalEnv& env) {
     if (params.size() != 1) {
         throw LispError("Error requires one argument.");
     }
     throw LispError(params[0]->toString());
 }
 
-ValuePtr builtins::eval(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::eval(Arguments params, EvalEnv& env) {
     if (params.size() != 1) {
         throw LispError("Eval requires one argument.");
     }
+    // The form is run in the frame of the caller, which is still live on
+    // the stack. Compiled code calls builtins with the global frame, as its
+    // locals live on the VM stack, so on the VM this is top level.
     return env.eval(params[0]);
 }
 
-ValuePtr builtins::exit(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::exit(Arguments params, EvalEnv& env) {
     if (params.size() > 1) {
         throw LispError("Exit does not take more than one arguments.");
     }
     // Exit the interpreter process with n as the exit code
     std::exit(params.size() == 0 ? 0 : params[0]->asNumber().value());
-    return std::make_shared<NilValue>();
+    return ValuePtr::nil();
 }
 
-ValuePtr builtins::newline(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::newline(Arguments params, EvalEnv& env) {
     if (params.size() > 0) {
         throw LispError("Newline does not take any arguments.");
     }
     std::cout << std::endl;
-    return std::make_shared<NilValue>();
+    return ValuePtr::nil();
 }
 
-ValuePtr builtins::print(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::print(Arguments params, EvalEnv& env) {
     if (params.size() < 1) {
         throw LispError("Print requires more than one argument.");
     }
     for (const auto& i : params) {
         std::cout << i->toString() << std::endl;
     }
-    return std::make_shared<NilValue>();
+    return ValuePtr::nil();
 }
 
-ValuePtr builtins::readline(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::readline(Arguments params, EvalEnv& env) {
     if (params.size() > 0) {
         throw LispError("Read does not take any arguments.");
     }
     std::cout << "> ";
     std::string line;
     std::getline(std::cin, line);
-    auto tokens = Tokenizer::tokenize(line);
-    Parser parser(std::move(tokens));
-    auto value = parser.parse();
-    auto result = env.eval(std::move(value));
-    return result;
+    auto value = Reader(line).read();
+    if (!value) {
+        return ValuePtr::nil();
+    }
+    return env.eval(std::move(*value));
 }
 
-ValuePtr builtins::help(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::help(Arguments params, EvalEnv& env) {
     if (params.size() > 0) {
         throw LispError("Help does not take any arguments.");
     }
@@ -172,6 +184,14 @@ ValuePtr builtins::help(const std::vector<ValuePtr>& params, EvalEnv& env) {
     for (const auto& i : builtins::cons_list_builtins) {
         std::cout << i.first << std::endl;
     }
+    std::cout << std::endl << "- Vector functions:" << std::endl;
+    for (const auto& i : builtins::vector_builtins) {
+        std::cout << i.first << std::endl;
+    }
+    std::cout << std::endl << "- Hash table functions:" << std::endl;
+    for (const auto& i : builtins::hash_table_builtins) {
+        std::cout << i.first << std::endl;
+    }
     std::cout << std::endl << "- Math functions:" << std::endl;
     for (const auto& i : builtins::math_builtins) {
         std::cout << i.first << std::endl;
@@ -180,605 +200,623 @@ ValuePtr builtins::help(const std::vector<ValuePtr>& params, EvalEnv& env) {
     for (const auto& i : builtins::comparison_builtins) {
         std::cout << i.first << std::endl;
     }
-    return std::make_shared<NilValue>();
+    std::cout << std::endl << "- String functions:" << std::endl;
+    for (const auto& i : builtins::string_builtins) {
+        std::cout << i.first << std::endl;
+    }
+    return ValuePtr::nil();
+}
+
+ValuePtr builtins::saveImage(Arguments params, EvalEnv& env) {
+    if (params.size() != 1) {
+        throw LispError("Save-image requires one argument.");
+    }
+    auto path = params[0]->asString();
+    if (!path) {
+        throw LispError("Save-image requires a file name as its argument.");
+    }
+    // Saves the global definitions, to be loaded with --image
+    image::save(*path, env);
+    return ValuePtr::nil();
 }
 
 
 // type checking library
 
-std::unordered_map<std::string, std::shared_ptr<BuiltinProcValue> > builtins::type_checking_builtins = {
+std::unordered_map<std::string, ValuePtr> builtins::type_checking_builtins = {
 
-    {"atom?", std::make_shared<BuiltinProcValue>(&builtins::isAtom)},
-    {"boolean?", std::make_shared<BuiltinProcValue>(&builtins::isBoolean)},
-    {"integer?", std::make_shared<BuiltinProcValue>(&builtins::isInteger)},
-    {"list?", std::make_shared<BuiltinProcValue>(&builtins::isList)},
-    {"number?", std::make_shared<BuiltinProcValue>(&builtins::isNumber)},
-    {"null?", std::make_shared<BuiltinProcValue>(&builtins::isNull)},
-    {"pair?", std::make_shared<BuiltinProcValue>(&builtins::isPair)},
-    {"procedure?", std::make_shared<BuiltinProcValue>(&builtins::isProcedure)},
-    {"string?", std::make_shared<BuiltinProcValue>(&builtins::isString)},
-    {"symbol?", std::make_shared<BuiltinProcValue>(&builtins::isSymbol)},
+    {"atom?", fixed<&builtins::isAtom, param::Any>("atom?")},
+    {"boolean?", fixed<&builtins::isBoolean, param::Any>("boolean?")},
+    {"integer?", fixed<&builtins::isInteger, param::Any>("integer?")},
+    {"list?", fixed<&builtins::isList, param::Any>("list?")},
+    {"number?", fixed<&builtins::isNumber, param::Any>("number?")},
+    {"null?", fixed<&builtins::isNull, param::Any>("null?")},
+    {"pair?", fixed<&builtins::isPair, param::Any>("pair?")},
+    {"procedure?", fixed<&builtins::isProcedure, param::Any>("procedure?")},
+    {"string?", fixed<&builtins::isString, param::Any>("string?")},
+    {"symbol?", fixed<&builtins::isSymbol, param::Any>("symbol?")},
+    {"vector?", fixed<&builtins::isVector, param::Any>("vector?")},
 
 };
 
 // atom = bool or number or string or symbol or nil
-ValuePtr builtins::isAtom(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Atom? requires one argument.");
-    }
-    bool flag = params[0]->isType(ValueType::BOOLEAN) ||
-                params[0]->isType(ValueType::NUMERIC) ||
-                params[0]->isType(ValueType::STRING)  ||
-                params[0]->isType(ValueType::SYMBOL)  ||
-                params[0]->isType(ValueType::NIL);
-    return std::make_shared<BooleanValue>(flag);
+ValuePtr builtins::isAtom(const ValuePtr& value) {
+    bool flag = value->isType(ValueType::BOOLEAN) ||
+                value->isType(ValueType::NUMERIC) ||
+                value->isType(ValueType::STRING)  ||
+                value->isType(ValueType::SYMBOL)  ||
+                value->isType(ValueType::NIL);
+    return ValuePtr::boolean(flag);
 }
 
-ValuePtr builtins::isBoolean(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Boolean? requires one argument.");
-    }
-    return std::make_shared<BooleanValue>(params[0]->isType(ValueType::BOOLEAN));
+ValuePtr builtins::isBoolean(const ValuePtr& value) {
+    return ValuePtr::boolean(value->isType(ValueType::BOOLEAN));
 }
 
-ValuePtr builtins::isInteger(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Integer? requires one argument.");
-    }
-    return std::make_shared<BooleanValue>(
-        params[0]->isType(ValueType::NUMERIC) && 
-        std::floor(params[0]->asNumber().value()) == params[0]->asNumber().value()
-    );
+ValuePtr builtins::isInteger(const ValuePtr& value) {
+    return ValuePtr::boolean(value->isType(ValueType::NUMERIC) && numbers::isInteger(value));
 }
 
-ValuePtr builtins::isList(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("List? requires one argument.");
-    }
-    if (!params[0]->isType(ValueType::PAIR) && !params[0]->isType(ValueType::NIL)) {
-        return std::make_shared<BooleanValue>(false);
+ValuePtr builtins::isList(const ValuePtr& value) {
+    if (!value->isType(ValueType::PAIR) && !value->isType(ValueType::NIL)) {
+        return ValuePtr::boolean(false);
     }
-    if (params[0]->isType(ValueType::NIL)) {
-        return std::make_shared<BooleanValue>(true);
+    if (value->isType(ValueType::NIL)) {
+        return ValuePtr::boolean(true);
     }
-    auto p = static_cast<PairValue*>(params[0].get());
-    while (p->getCdr()->isType(ValueType::PAIR)) {
-        p = static_cast<PairValue*>(p->getCdr().get());
-    }
-    return std::make_shared<BooleanValue>(p->getCdr()->isType(ValueType::NIL));
+    return ValuePtr::boolean(ListView(value).isProper());
 }
 
-ValuePtr builtins::isNumber(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Number? requires one argument.");
-    }
-    return std::make_shared<BooleanValue>(params[0]->isType(ValueType::NUMERIC));
+ValuePtr builtins::isNumber(const ValuePtr& value) {
+    return ValuePtr::boolean(value->isType(ValueType::NUMERIC));
 }
 
-ValuePtr builtins::isNull(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Null? requires one argument.");
-    }
-    return std::make_shared<BooleanValue>(params[0]->isType(ValueType::NIL));
+ValuePtr builtins::isNull(const ValuePtr& value) {
+    return ValuePtr::boolean(value->isType(ValueType::NIL));
 }
 
-ValuePtr builtins::isPair(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Pair? requires one argument.");
-    }
-    return std::make_shared<BooleanValue>(params[0]->isType(ValueType::PAIR));
+ValuePtr builtins::isPair(const ValuePtr& value) {
+    return ValuePtr::boolean(value->isType(ValueType::PAIR));
 }
 
-ValuePtr builtins::isProcedure(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Procedure? requires one argument.");
-    }
-    return std::make_shared<BooleanValue>(
-        params[0]->isType(ValueType::BUILTIN) ||
-        params[0]->isType(ValueType::LAMBDA)
+ValuePtr builtins::isProcedure(const ValuePtr& value) {
+    return ValuePtr::boolean(
+        value->isType(ValueType::BUILTIN) ||
+        value->isType(ValueType::LAMBDA)
     );
 }
 
-ValuePtr builtins::isString(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("String? requires one argument.");
-    }
-    return std::make_shared<BooleanValue>(params[0]->isType(ValueType::STRING));
+ValuePtr builtins::isString(const ValuePtr& value) {
+    return ValuePtr::boolean(value->isType(ValueType::STRING));
 }
 
-ValuePtr builtins::isSymbol(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Symbol? requires one argument.");
-    }
-    return std::make_shared<BooleanValue>(params[0]->isType(ValueType::SYMBOL));
+ValuePtr builtins::isSymbol(const ValuePtr& value) {
+    return ValuePtr::boolean(value->isType(ValueType::SYMBOL));
+}
+
+ValuePtr builtins::isVector(const ValuePtr& value) {
+    return ValuePtr::boolean(value->isType(ValueType::VECTOR));
 }
 
 
 // cons_list library
-std::unordered_map<std::string, std::shared_ptr<BuiltinProcValue> > builtins::cons_list_builtins = {
-
-    {"car", std::make_shared<BuiltinProcValue>(&builtins::car)},
-    {"cdr", std::make_shared<BuiltinProcValue>(&builtins::cdr)},
-    {"cons", std::make_shared<BuiltinProcValue>(&builtins::cons)},
-    {"length", std::make_shared<BuiltinProcValue>(&builtins::length)},
-    {"list", std::make_shared<BuiltinProcValue>(&builtins::list)},
-    {"append", std::make_shared<BuiltinProcValue>(&builtins::append)},
-    {"map", std::make_shared<BuiltinProcValue>(&builtins::map)},
-    {"filter", std::make_shared<BuiltinProcValue>(&builtins::filter)},
-    {"reduce", std::make_shared<BuiltinProcValue>(&builtins::reduce)},
+std::unordered_map<std::string, ValuePtr> builtins::cons_list_builtins = {
+
+    {"car", fixed<&builtins::car, param::Pair>("car")},
+    {"cdr", fixed<&builtins::cdr, param::Pair>("cdr")},
+    {"cons", fixed<&builtins::cons, param::Any, param::Any>("cons")},
+    {"length", fixed<&builtins::length, param::List>("length")},
+    {"list", makeValue<BuiltinProcValue>(&builtins::list)},
+    {"append", makeValue<BuiltinProcValue>(&builtins::append)},
+    {"map", makeValue<BuiltinProcValue>(&builtins::map)},
+    {"filter", makeValue<BuiltinProcValue>(&builtins::filter)},
+    {"reduce", makeValue<BuiltinProcValue>(&builtins::reduce)},
 
 };
 
-ValuePtr builtins::car(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Car requires one argument.");
-    }
-    if (!params[0]->isType(ValueType::PAIR)) {
-        throw LispError("Car requires a pair.");
-    }
-    return static_cast<PairValue*>(params[0].get())->getCar();
+ValuePtr builtins::car(const ValuePtr& pair) {
+    return static_cast<PairValue*>(pair.get())->getCar();
 }
 
-ValuePtr builtins::cdr(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Cdr requires one argument.");
-    }
-    if (!params[0]->isType(ValueType::PAIR)) {
-        throw LispError("Cdr requires a pair.");
-    }
-    return static_cast<PairValue*>(params[0].get())->getCdr();
+ValuePtr builtins::cdr(const ValuePtr& pair) {
+    return static_cast<PairValue*>(pair.get())->getCdr();
 }
 
-ValuePtr builtins::cons(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 2) {
-        throw LispError("Cons requires two arguments.");
-    }
-    return std::make_shared<PairValue>(params[0], params[1]);
+ValuePtr builtins::cons(const ValuePtr& car, const ValuePtr& cdr) {
+    return makeValue<PairValue>(car, cdr);
 }
 
-ValuePtr builtins::length(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Length requires one argument.");
-    }
-    if (!params[0]->isType(ValueType::PAIR) && !params[0]->isType(ValueType::NIL)) {
-        throw LispError("Length requires a pair.");
-    }
-    if (params[0]->isType(ValueType::NIL)) {
-        return std::make_shared<NumericValue>(0);
-    }
-    int result = 0;
-    auto p = static_cast<PairValue*>(params[0].get());
-    while (p->getCdr()->isType(ValueType::PAIR)) {
-        p = static_cast<PairValue*>(p->getCdr().get());
-        result++;
-    }
-    result++;
-    return std::make_shared<NumericValue>(result);
+ValuePtr builtins::length(const ValuePtr& list) {
+    return ValuePtr::integer(ListView(list).size());
 }
 
-ValuePtr builtins::list(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() == 0) {
-        return std::make_shared<NilValue>();
-    }
-    return std::make_shared<PairValue>(params);
+ValuePtr builtins::list(Arguments params, EvalEnv& env) {
+    return makeList(params);
 }
 
-ValuePtr builtins::append(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() == 0) {
-        return std::make_shared<NilValue>();
-    }
-    std::vector<ValuePtr> result;
+ValuePtr builtins::append(Arguments params, EvalEnv& env) {
+    ListBuilder result;
     for (const auto& i : params) {
-        if (i->isType(ValueType::PAIR)) {
-            auto list = i->toVector();
-            result.insert(result.end(), list.begin(), list.end());
-        } else if (!i->isType(ValueType::NIL)) {
+        if (!ListView(i).isProper()) {
             throw LispError("Append requires lists or nil.");
         }
+        for (const auto& element : ListView(i)) {
+            result.push(element);
+        }
     }
-    if (result.empty()) {
-        return std::make_shared<NilValue>();
-    } else {
-        return std::make_shared<PairValue>(result);
-    }
+    return result.finish();
 }
 
-ValuePtr builtins::map(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::map(Arguments params, EvalEnv& env) {
     if (params.size() != 2) {
         throw LispError("Map requires two arguments.");
     }
     if (!params[0]->isType(ValueType::BUILTIN) && !params[0]->isType(ValueType::LAMBDA)) {
         throw LispError("Map requires a procedure as its first argument.");
     }
-    if (!params[1]->isType(ValueType::PAIR)) {
+    if (!params[1]->isType(ValueType::PAIR) || !ListView(params[1]).isProper()) {
         throw LispError("Map requires a pair as its second argument.");
     }
     auto proc = params[0];
-    auto list = params[1]->toVector();
-    std::vector<ValuePtr> result;
-    std::ranges::transform(
-        list, 
-        std::back_inserter(result), 
-        [proc, &env](ValuePtr v) { return proc->call({v}, env); }
-    );
-    return std::make_shared<PairValue>(result);
+    ListBuilder result;
+    for (const auto& element : ListView(params[1])) {
+        result.push(proc->call({element}, env));
+    }
+    return result.finish();
 }
 
-ValuePtr builtins::filter(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::filter(Arguments params, EvalEnv& env) {
     if (params.size() != 2) {
         throw LispError("Filter requires two arguments.");
     }
     if (!params[0]->isType(ValueType::BUILTIN) && !params[0]->isType(ValueType::LAMBDA)) {
         throw LispError("Filter requires a procedure as its first argument.");
     }
-    if (!params[1]->isType(ValueType::PAIR)) {
-        if (params[1]->isType(ValueType::NIL)) {
-            return std::make_shared<NilValue>();
-        } else {
-            throw LispError("Filter requires a pair as its second argument.");
-        }
+    if (!ListView(params[1]).isProper()) {
+        throw LispError("Filter requires a pair as its second argument.");
     }
     auto proc = params[0];
-    auto list = params[1]->toVector();
-    std::vector<ValuePtr> result;
-    std::ranges::copy_if(
-        list, 
-        std::back_inserter(result), 
-        [proc, &env](ValuePtr v) { return proc->call({v}, env)->asBoolean(); }
-    );
-    if (result.empty()) {
-        return std::make_shared<NilValue>();
-    } else {
-        return std::make_shared<PairValue>(result);
-    }
-}
-
-ValuePtr reduce_recursive(ValuePtr proc, std::vector<ValuePtr> list, EvalEnv& env) {
-    if (list.size() == 0) {
-        throw LispError("Cannot reduce an empty list.");
-    }
-    if (list.size() == 1) {
-        return list[0];
+    ListBuilder result;
+    for (const auto& element : ListView(params[1])) {
+        if (proc->call({element}, env)->asBoolean()) {
+            result.push(element);
+        }
     }
-    return proc->call(
-        std::vector<ValuePtr>({
-            list[0], 
-            reduce_recursive(proc, std::vector(list.begin() + 1, list.end()), env)
-        }), 
-        env
-    );
+    return result.finish();
 }
 
-ValuePtr builtins::reduce(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::reduce(Arguments params, EvalEnv& env) {
     if (params.size() != 2) {
         throw LispError("Reduce requires three arguments.");
     }
     if (!params[0]->isType(ValueType::BUILTIN) && !params[0]->isType(ValueType::LAMBDA)) {
         throw LispError("Reduce requires a procedure as its first argument.");
     }
-    if (!params[1]->isType(ValueType::PAIR)) {
+    if (!params[1]->isType(ValueType::PAIR) || !ListView(params[1]).isProper()) {
         throw LispError("Reduce requires a pair as its second argument.");
     }
+    // The fold is to the right, so the elements are combined from the
+    // back; only their handles are collected for that.
     auto proc = params[0];
-    auto list = params[1]->toVector();
-    return reduce_recursive(proc, list, env);
+    std::vector<const ValuePtr*> list;
+    for (const auto& element : ListView(params[1])) {
+        list.push_back(&element);
+    }
+    ValuePtr result = *list.back();
+    for (size_t i = list.size() - 1; i > 0; i--) {
+        result = proc->call({*list[i - 1], result}, env);
+    }
+    return result;
 }
 
 
-// math library
+// vector library
 
-std::unordered_map<std::string, std::shared_ptr<BuiltinProcValue> > builtins::math_builtins = {
+std::unordered_map<std::string, ValuePtr> builtins::vector_builtins = {
 
-    {"+", std::make_shared<BuiltinProcValue>(&builtins::addVal)},
-    {"-", std::make_shared<BuiltinProcValue>(&builtins::subVal)},
-    {"*", std::make_shared<BuiltinProcValue>(&builtins::mulVal)},
-    {"/", std::make_shared<BuiltinProcValue>(&builtins::divVal)},
-    {"abs", std::make_shared<BuiltinProcValue>(&builtins::absVal)},
-    {"expt", std::make_shared<BuiltinProcValue>(&builtins::exptVal)},
-    {"quotient", std::make_shared<BuiltinProcValue>(&builtins::quotientVal)},
-    {"remainder", std::make_shared<BuiltinProcValue>(&builtins::remainderVal)},
-    {"modulo", std::make_shared<BuiltinProcValue>(&builtins::moduloVal)},
+    {"make-vector", makeValue<BuiltinProcValue>(&builtins::makeVector)},
+    {"vector", makeValue<BuiltinProcValue>(&builtins::vector)},
+    {"vector-ref", fixed<&builtins::vectorRef, param::Vector, param::Any>("vector-ref")},
+    {"vector-set!", fixed<&builtins::vectorSet, param::Vector, param::Any, param::Any>("vector-set!")},
+    {"vector-length", fixed<&builtins::vectorLength, param::Vector>("vector-length")},
+    {"vector->list", makeValue<BuiltinProcValue>(&builtins::vectorToList)},
+    {"list->vector", makeValue<BuiltinProcValue>(&builtins::listToVector)},
+    {"vector-map", makeValue<BuiltinProcValue>(&builtins::vectorMap)},
+    {"vector-fill!", makeValue<BuiltinProcValue>(&builtins::vectorFill)},
 
 };
 
-ValuePtr builtins::addVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    double result = 0;
-    for (const auto& i : params) {
-        if (!i->isType(ValueType::NUMERIC)) {
-            throw LispError("Cannot add a non-numeric value.");
-        }
-        result += i->asNumber().value();
+// Position of index in a vector of the given size, which it must be
+// an exact non-negative integer below.
+size_t vectorIndex(const ValuePtr& index, size_t size, const std::string& name) {
+    if (!index->isFixnum() || index->getFixnum() < 0) {
+        throw LispError(name + " requires an exact non-negative integer index.");
     }
-    return std::make_shared<NumericValue>(result);
-}
-
-ValuePtr builtins::subVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() < 1 || params.size() > 2) {
-        throw LispError("Subtraction requires two argument.");
-    } 
-    double result;
-    if (params.size() == 1) {
-        if (!params[0]->isType(ValueType::NUMERIC)) {
-            throw LispError("Cannot subtract a non-numeric value.");
-        } else {
-            result = -params[0]->asNumber().value();
-        }
-    } else {
-        if (!params[0]->isType(ValueType::NUMERIC) || !params[1]->isType(ValueType::NUMERIC)) {
-            throw LispError("Cannot subtract a non-numeric value.");
-        } else {
-            result = params[0]->asNumber().value() - params[1]->asNumber().value();
-        }
+    if (static_cast<size_t>(index->getFixnum()) >= size) {
+        throw LispError(name + " index " + index->toString() + " is out of range.");
     }
-    return std::make_shared<NumericValue>(result);
+    return static_cast<size_t>(index->getFixnum());
 }
 
-ValuePtr builtins::mulVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    double result = 1;
-    for (const auto& i : params) {
-        if (!i->isType(ValueType::NUMERIC)) {
-            throw LispError("Cannot multiply a non-numeric value.");
-        }
-        result *= i->asNumber().value();
+VectorValue& vectorArgument(const ValuePtr& value, const std::string& name) {
+    if (!value->isType(ValueType::VECTOR)) {
+        throw LispError(name + " requires a vector as its first argument.");
     }
-    return std::make_shared<NumericValue>(result);
+    return *static_cast<VectorValue*>(value.get());
 }
 
-ValuePtr builtins::divVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::makeVector(Arguments params, EvalEnv& env) {
     if (params.size() < 1 || params.size() > 2) {
-        throw LispError("Division requires two arguments.");
+        throw LispError("Make-vector requires one or two arguments.");
     }
-    double result;
-    if (params.size() == 1) {
-        if (params[0]->asNumber().value() == 0) {
-            throw LispError("Cannot divide by zero.");
-        }
-        if (!params[0]->isType(ValueType::NUMERIC)) {
-            throw LispError("Cannot divide a non-numeric value.");
-        }
-        result = 1 / params[0]->asNumber().value();
-    } else {
-        if (params[1]->asNumber().value() == 0) {
-            throw LispError("Cannot divide by zero.");
-        }
-        if (!params[0]->isType(ValueType::NUMERIC) || !params[1]->isType(ValueType::NUMERIC)) {
-            throw LispError("Cannot divide a non-numeric value.");
+    if (!params[0]->isFixnum() || params[0]->getFixnum() < 0) {
+        throw LispError("Make-vector requires an exact non-negative integer size.");
+    }
+    auto fill = params.size() == 2 ? params[1] : ValuePtr::fixnum(0);
+    auto size = static_cast<size_t>(params[0]->getFixnum());
+    std::vector<ValuePtr> elements;
+    try {
+        if (size > elements.max_size()) {
+            throw std::bad_alloc();
         }
-        result = params[0]->asNumber().value() / params[1]->asNumber().value();
+        elements.assign(size, fill);
+    } catch (std::bad_alloc&) {
+        throw LispError("Make-vector cannot allocate " + params[0]->toString() + " elements.");
     }
-    return std::make_shared<NumericValue>(result);
+    return makeValue<VectorValue>(std::move(elements));
 }
 
-ValuePtr builtins::absVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Abs requires one argument.");
-    }
-    if (!params[0]->isType(ValueType::NUMERIC)) {
-        throw LispError("Cannot get the absolute value of a non-numeric value.");
-    }
-    return std::make_shared<NumericValue>(std::abs(params[0]->asNumber().value()));
+ValuePtr builtins::vector(Arguments params, EvalEnv& env) {
+    return makeValue<VectorValue>(std::vector<ValuePtr>(params.begin(), params.end()));
 }
 
-ValuePtr builtins::exptVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 2) {
-        throw LispError("Expt requires two arguments.");
-    }
-    if (!params[0]->isType(ValueType::NUMERIC) || !params[1]->isType(ValueType::NUMERIC)) {
-        throw LispError("Cannot raise a non-numeric value to a power.");
-    }
-    if (params[0]->asNumber().value() == 0 && params[1]->asNumber().value() <= 0) {
-        throw LispError("Cannot raise zero to a non-positive power.");
+ValuePtr builtins::vectorRef(const ValuePtr& vector, const ValuePtr& index) {
+    auto& elements = static_cast<VectorValue*>(vector.get())->getElements();
+    return elements[vectorIndex(index, elements.size(), "Vector-ref")];
+}
+
+ValuePtr builtins::vectorSet(const ValuePtr& vector, const ValuePtr& index, const ValuePtr& value) {
+    auto& elements = static_cast<VectorValue*>(vector.get())->getElements();
+    elements[vectorIndex(index, elements.size(), "Vector-set!")] = value;
+    return ValuePtr::nil();
+}
+
+ValuePtr builtins::vectorLength(const ValuePtr& vector) {
+    return ValuePtr::integer(static_cast<VectorValue*>(vector.get())->getElements().size());
+}
+
+ValuePtr builtins::vectorToList(Arguments params, EvalEnv& env) {
+    if (params.size() != 1) {
+        throw LispError("Vector->list requires one argument.");
     }
-    return std::make_shared<NumericValue>(std::pow(params[0]->asNumber().value(), params[1]->asNumber().value()));
+    return makeList(vectorArgument(params[0], "Vector->list").getElements());
 }
 
-ValuePtr builtins::quotientVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 2) {
-        throw LispError("Quotient requires two arguments.");
+ValuePtr builtins::listToVector(Arguments params, EvalEnv& env) {
+    if (params.size() != 1) {
+        throw LispError("List->vector requires one argument.");
     }
-    if (!params[0]->isType(ValueType::NUMERIC) || !params[1]->isType(ValueType::NUMERIC)) {
-        throw LispError("Cannot divide a non-numeric value.");
+    ListView list(params[0]);
+    if (!list.isProper()) {
+        throw LispError("List->vector requires a list.");
     }
-    return std::make_shared<NumericValue>(static_cast<int>(params[0]->asNumber().value() / params[1]->asNumber().value()));
+    std::vector<ValuePtr> elements;
+    elements.reserve(list.size());
+    std::ranges::copy(list, std::back_inserter(elements));
+    return makeValue<VectorValue>(std::move(elements));
 }
 
-ValuePtr builtins::remainderVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::vectorMap(Arguments params, EvalEnv& env) {
     if (params.size() != 2) {
-        throw LispError("Remainder requires two arguments.");
+        throw LispError("Vector-map requires two arguments.");
     }
-    if (!params[0]->isType(ValueType::NUMERIC) || !params[1]->isType(ValueType::NUMERIC)) {
-        throw LispError("Cannot divide a non-numeric value.");
+    if (!params[0]->isType(ValueType::BUILTIN) && !params[0]->isType(ValueType::LAMBDA)) {
+        throw LispError("Vector-map requires a procedure as its first argument.");
     }
-    if (params[1]->asNumber().value() == 0) {
-        throw LispError("Cannot divide by zero.");
+    if (!params[1]->isType(ValueType::VECTOR)) {
+        throw LispError("Vector-map requires a vector as its second argument.");
+    }
+    // The procedure may change the vector, so elements are read by index.
+    auto& source = static_cast<VectorValue*>(params[1].get())->getElements();
+    std::vector<ValuePtr> result;
+    result.reserve(source.size());
+    for (size_t i = 0; i < source.size(); i++) {
+        result.push_back(params[0]->call({source[i]}, env));
     }
-    return std::make_shared<NumericValue>(static_cast<int>(params[0]->asNumber().value()) % std::abs(static_cast<int>(params[1]->asNumber().value())));
+    return makeValue<VectorValue>(std::move(result));
 }
 
-ValuePtr builtins::moduloVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::vectorFill(Arguments params, EvalEnv& env) {
     if (params.size() != 2) {
-        throw LispError("Modulo requires two arguments.");
+        throw LispError("Vector-fill! requires two arguments.");
     }
-    if (!params[0]->isType(ValueType::NUMERIC) || !params[1]->isType(ValueType::NUMERIC)) {
-        throw LispError("Cannot perform modulo on non-numeric values.");
-    }
-    double x = params[0]->asNumber().value();
-    double y = params[1]->asNumber().value();
-    if (y == 0) {
-        throw LispError("Cannot divide by zero.");
-    }
-    int result = static_cast<int>(std::abs(x)) % static_cast<int>(std::abs(y));
-    if (x * y < 0) {
-        result = std::abs(y) - result;
-    }
-    return std::make_shared<NumericValue>(y > 0 ? result : -result);
+    auto& elements = vectorArgument(params[0], "Vector-fill!").getElements();
+    std::ranges::fill(elements, params[1]);
+    return ValuePtr::nil();
 }
 
-// comparison library
 
-std::unordered_map<std::string, std::shared_ptr<BuiltinProcValue> > builtins::comparison_builtins = {
+// hash table library
+
+std::unordered_map<std::string, ValuePtr> builtins::hash_table_builtins = {
 
-    {"eq?", std::make_shared<BuiltinProcValue>(&builtins::dataEq)},
-    {"equal?", std::make_shared<BuiltinProcValue>(&builtins::dataEqual)},
-    {"not", std::make_shared<BuiltinProcValue>(&builtins::notVal)},
-    {"=", std::make_shared<BuiltinProcValue>(&builtins::eqVal)},
-    {"<", std::make_shared<BuiltinProcValue>(&builtins::ltVal)},
-    {">", std::make_shared<BuiltinProcValue>(&builtins::gtVal)},
-    {"<=", std::make_shared<BuiltinProcValue>(&builtins::leVal)},
-    {">=", std::make_shared<BuiltinProcValue>(&builtins::geVal)},
-    {"even?", std::make_shared<BuiltinProcValue>(&builtins::isEven)},
-    {"odd?", std::make_shared<BuiltinProcValue>(&builtins::isOdd)},
-    {"zero?", std::make_shared<BuiltinProcValue>(&builtins::isZero)},
+    {"make-hash-table", makeValue<BuiltinProcValue>(&builtins::makeHashTable)},
+    {"hash-ref", makeValue<BuiltinProcValue>(&builtins::hashRef)},
+    {"hash-set!", fixed<&builtins::hashSet, param::HashTable, param::Any, param::Any>("hash-set!")},
+    {"hash-remove!", fixed<&builtins::hashRemove, param::HashTable, param::Any>("hash-remove!")},
+    {"hash-count", fixed<&builtins::hashCount, param::HashTable>("hash-count")},
+    {"hash-keys", makeValue<BuiltinProcValue>(&builtins::hashKeys)},
+    {"hash-for-each", makeValue<BuiltinProcValue>(&builtins::hashForEach)},
 
 };
 
-ValuePtr builtins::dataEq(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 2) {
-        throw LispError("Eq? requires two arguments.");
+HashTableValue& hashTableArgument(const ValuePtr& value, const std::string& name) {
+    if (!value->isType(ValueType::HASH_TABLE)) {
+        throw LispError(name + " requires a hash table as its first argument.");
     }
-    if (params[0]->getType() != params[1]->getType()) {
-        return std::make_shared<BooleanValue>(false);
+    return *static_cast<HashTableValue*>(value.get());
+}
+
+// (make-hash-table) compares keys with equal?, (make-hash-table 'eq?)
+// with eq?.
+ValuePtr builtins::makeHashTable(Arguments params, EvalEnv& env) {
+    if (params.size() > 1) {
+        throw LispError("Make-hash-table takes at most one argument.");
     }
-    if (params[0]->isType(ValueType::BOOLEAN) ||
-        params[0]->isType(ValueType::NUMERIC) ||
-        params[0]->isType(ValueType::BUILTIN) ||
-        params[0]->isType(ValueType::SYMBOL)  ||
-        params[0]->isType(ValueType::NIL)         
-    ) {
-        return builtins::dataEqual(params, env);
-    } else if (params[0]->isType(ValueType::STRING) ||
-               params[0]->isType(ValueType::PAIR)
-    ) {
-        return std::make_shared<BooleanValue>(params[0].get() == params[1].get());
-    } else {
-        throw LispError("Cannot compare this type of value.");
+    auto kind = HashTableValue::Kind::EQUAL;
+    if (params.size() == 1) {
+        auto name = params[0]->asSymbol();
+        if (name == Symbol::intern("eq?")) {
+            kind = HashTableValue::Kind::EQ;
+        } else if (name != Symbol::intern("equal?")) {
+            throw LispError("Make-hash-table requires 'eq? or 'equal? as its argument.");
+        }
     }
+    return makeValue<HashTableValue>(kind);
 }
 
-ValuePtr builtins::dataEqual(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 2) {
-        throw LispError("Eq? requires two arguments.");
+ValuePtr builtins::hashRef(Arguments params, EvalEnv& env) {
+    if (params.size() < 2 || params.size() > 3) {
+        throw LispError("Hash-ref requires two or three arguments.");
     }
-    if (params[0]->getType() != params[1]->getType()) {
-        return std::make_shared<BooleanValue>(false);
-    } else if (params[0]->isType(ValueType::BUILTIN) ||
-               params[0]->isType(ValueType::LAMBDA)) {
-        throw LispError("Cannot compare procedures.");
-    } else if (params[0]->isType(ValueType::PAIR)) {
-        auto head = static_cast<PairValue*>(params[0].get());
-        auto tail = static_cast<PairValue*>(params[1].get());
-        return std::make_shared<BooleanValue>(
-            builtins::dataEqual(std::vector<ValuePtr>({head->getCar(), tail->getCar()}), env)->asBoolean() &&
-            builtins::dataEqual(std::vector<ValuePtr>({head->getCdr(), tail->getCdr()}), env)->asBoolean()
-        );
-    } else if (params[0]->isType(ValueType::SYMBOL)) {
-        return std::make_shared<BooleanValue>(params[0]->asSymbol().value() == params[1]->asSymbol().value());
-    } else if (params[0]->isType(ValueType::STRING)) {
-        return std::make_shared<BooleanValue>(params[0]->asString().value() == params[1]->asString().value());
-    } else if (params[0]->isType(ValueType::NUMERIC)) {
-        return std::make_shared<BooleanValue>(params[0]->asNumber().value() == params[1]->asNumber().value());
-    } else if (params[0]->isType(ValueType::BOOLEAN)) {
-        return std::make_shared<BooleanValue>(params[0]->asBoolean() == params[1]->asBoolean());
-    } else if (params[0]->isType(ValueType::NIL)) {
-        return std::make_shared<BooleanValue>(true);
-    } else {
-        throw LispError("Cannot compare this type of value.");
+    if (auto value = hashTableArgument(params[0], "Hash-ref").lookup(params[1])) {
+        return *value;
     }
+    if (params.size() == 3) {
+        return params[2];
+    }
+    throw LispError("Hash-ref: no value for key " + params[1]->toString());
+}
+
+ValuePtr builtins::hashSet(const ValuePtr& table, const ValuePtr& key, const ValuePtr& value) {
+    static_cast<HashTableValue*>(table.get())->set(key, value);
+    return ValuePtr::nil();
 }
 
-ValuePtr builtins::notVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::hashRemove(const ValuePtr& table, const ValuePtr& key) {
+    static_cast<HashTableValue*>(table.get())->remove(key);
+    return ValuePtr::nil();
+}
+
+ValuePtr builtins::hashCount(const ValuePtr& table) {
+    return ValuePtr::integer(static_cast<HashTableValue*>(table.get())->size());
+}
+
+ValuePtr builtins::hashKeys(Arguments params, EvalEnv& env) {
     if (params.size() != 1) {
-        throw LispError("Not requires one argument.");
+        throw LispError("Hash-keys requires one argument.");
     }
-    bool flag = false;
-    if (params[0]->asBoolean() == false) {
-        flag = true;
+    ListBuilder result;
+    for (auto& [key, value] : hashTableArgument(params[0], "Hash-keys").items()) {
+        result.push(std::move(key));
     }
-    return std::make_shared<BooleanValue>(flag);
+    return result.finish();
 }
 
-ValuePtr builtins::eqVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr builtins::hashForEach(Arguments params, EvalEnv& env) {
     if (params.size() != 2) {
-        throw LispError("= requires two arguments.");
+        throw LispError("Hash-for-each requires two arguments.");
     }
-    if (!params[0]->isType(ValueType::NUMERIC) || !params[1]->isType(ValueType::NUMERIC)) {
-        throw LispError("Cannot compare a non-numeric value.");
+    if (!params[1]->isType(ValueType::BUILTIN) && !params[1]->isType(ValueType::LAMBDA)) {
+        throw LispError("Hash-for-each requires a procedure as its second argument.");
+    }
+    // The procedure sees the entries as they were when the walk started,
+    // even if it changes the table.
+    for (const auto& [key, value] : hashTableArgument(params[0], "Hash-for-each").items()) {
+        params[1]->call({key, value}, env);
     }
-    return std::make_shared<BooleanValue>(params[0]->asNumber().value() == params[1]->asNumber().value());
+    return ValuePtr::nil();
 }
 
-ValuePtr builtins::ltVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 2) {
-        throw LispError("< requires two arguments.");
-    }
-    if (!params[0]->isType(ValueType::NUMERIC) || !params[1]->isType(ValueType::NUMERIC)) {
-        throw LispError("Cannot compare a non-numeric value.");
+
+// math library
+
+std::unordered_map<std::string, ValuePtr> builtins::math_builtins = {
+
+    {"+", fixed<&numbers::add, param::Number, param::Number>("+", &builtins::addVal)},
+    {"-", fixed<&numbers::subtract, param::Number, param::Number>("-", &builtins::subVal)},
+    {"*", fixed<&numbers::multiply, param::Number, param::Number>("*", &builtins::mulVal)},
+    {"/", fixed<&numbers::divide, param::Number, param::Number>("/", &builtins::divVal)},
+    {"abs", fixed<&numbers::abs, param::Number>("abs")},
+    {"expt", fixed<&numbers::expt, param::Number, param::Number>("expt")},
+    {"quotient", fixed<&numbers::quotient, param::Number, param::Number>("quotient")},
+    {"remainder", fixed<&numbers::remainder, param::Number, param::Number>("remainder")},
+    {"modulo", fixed<&numbers::modulo, param::Number, param::Number>("modulo")},
+
+};
+
+ValuePtr builtins::addVal(Arguments params, EvalEnv& env) {
+    ValuePtr result = ValuePtr::fixnum(0);
+    for (const auto& i : params) {
+        if (!i->isType(ValueType::NUMERIC)) {
+            throw LispError("Cannot add a non-numeric value.");
+        }
+        result = numbers::add(result, i);
     }
-    return std::make_shared<BooleanValue>(params[0]->asNumber().value() < params[1]->asNumber().value());
+    return result;
 }
 
-ValuePtr builtins::gtVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 2) {
-        throw LispError("> requires two arguments.");
+ValuePtr builtins::subVal(Arguments params, EvalEnv& env) {
+    if (params.size() < 1 || params.size() > 2) {
+        throw LispError("Subtraction requires two argument.");
+    } 
+    if (params.size() == 1) {
+        if (!params[0]->isType(ValueType::NUMERIC)) {
+            throw LispError("Cannot subtract a non-numeric value.");
+        }
+        return numbers::negate(params[0]);
     }
     if (!params[0]->isType(ValueType::NUMERIC) || !params[1]->isType(ValueType::NUMERIC)) {
-        throw LispError("Cannot compare a non-numeric value.");
+        throw LispError("Cannot subtract a non-numeric value.");
     }
-    return std::make_shared<BooleanValue>(params[0]->asNumber().value() > params[1]->asNumber().value());
+    return numbers::subtract(params[0], params[1]);
 }
 
-ValuePtr builtins::leVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 2) {
-        throw LispError("<= requires two arguments.");
-    }
-    if (!params[0]->isType(ValueType::NUMERIC) || !params[1]->isType(ValueType::NUMERIC)) {
-        throw LispError("Cannot compare a non-numeric value.");
+ValuePtr builtins::mulVal(Arguments params, EvalEnv& env) {
+    ValuePtr result = ValuePtr::fixnum(1);
+    for (const auto& i : params) {
+        if (!i->isType(ValueType::NUMERIC)) {
+            throw LispError("Cannot multiply a non-numeric value.");
+        }
+        result = numbers::multiply(result, i);
     }
-    return std::make_shared<BooleanValue>(params[0]->asNumber().value() <= params[1]->asNumber().value());
+    return result;
 }
 
-ValuePtr builtins::geVal(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 2) {
-        throw LispError(">= requires two arguments.");
+ValuePtr builtins::divVal(Arguments params, EvalEnv& env) {
+    if (params.size() < 1 || params.size() > 2) {
+        throw LispError("Division requires two arguments.");
     }
-    if (!params[0]->isType(ValueType::NUMERIC) || !params[1]->isType(ValueType::NUMERIC)) {
-        throw LispError("Cannot compare a non-numeric value.");
+    for (const auto& i : params) {
+        if (!i->isType(ValueType::NUMERIC)) {
+            throw LispError("Cannot divide a non-numeric value.");
+        }
+    }
+    if (params.size() == 1) {
+        return numbers::divide(ValuePtr::fixnum(1), params[0]);
     }
-    return std::make_shared<BooleanValue>(params[0]->asNumber().value() >= params[1]->asNumber().value());
+    return numbers::divide(params[0], params[1]);
 }
 
-ValuePtr builtins::isEven(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Even? requires one argument.");
-    }
-    if (!params[0]->isType(ValueType::NUMERIC)) {
-        throw LispError("Cannot compare a non-numeric value.");
+// comparison library
+
+std::unordered_map<std::string, ValuePtr> builtins::comparison_builtins = {
+
+    {"eq?", fixed<&builtins::dataEq, param::Any, param::Any>("eq?")},
+    {"equal?", fixed<&builtins::dataEqual, param::Any, param::Any>("equal?")},
+    {"not", fixed<&builtins::notVal, param::Any>("not")},
+    {"=", fixed<&builtins::eqVal, param::Number, param::Number>("=")},
+    {"<", fixed<&builtins::ltVal, param::Number, param::Number>("<")},
+    {">", fixed<&builtins::gtVal, param::Number, param::Number>(">")},
+    {"<=", fixed<&builtins::leVal, param::Number, param::Number>("<=")},
+    {">=", fixed<&builtins::geVal, param::Number, param::Number>(">=")},
+    {"even?", fixed<&builtins::isEven, param::Number>("even?")},
+    {"odd?", fixed<&builtins::isOdd, param::Number>("odd?")},
+    {"zero?", fixed<&builtins::isZero, param::Number>("zero?")},
+
+};
+
+ValuePtr builtins::dataEq(const ValuePtr& left, const ValuePtr& right) {
+    if (left->getType() != right->getType()) {
+        return ValuePtr::boolean(false);
     }
-    if (std::floor(params[0]->asNumber().value()) != params[0]->asNumber().value()) {
-        throw LispError("Cannot compare a non-integer value.");
+    if (left->isType(ValueType::BOOLEAN) ||
+        left->isType(ValueType::NUMERIC) ||
+        left->isType(ValueType::BUILTIN) ||
+        left->isType(ValueType::SYMBOL)  ||
+        left->isType(ValueType::NIL)         
+    ) {
+        return builtins::dataEqual(left, right);
+    } else if (left->isType(ValueType::STRING) ||
+               left->isType(ValueType::PAIR) ||
+               left->isType(ValueType::VECTOR) ||
+               left->isType(ValueType::HASH_TABLE)
+    ) {
+        return ValuePtr::boolean(left.get() == right.get());
+    } else {
+        throw LispError("Cannot compare this type of value.");
     }
-    return std::make_shared<BooleanValue>(static_cast<int>(params[0]->asNumber().value()) % 2 == 0);
 }
 
-ValuePtr builtins::isOdd(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Odd? requires one argument.");
-    }
-    if (!params[0]->isType(ValueType::NUMERIC)) {
-        throw LispError("Cannot compare a non-numeric value.");
+ValuePtr builtins::dataEqual(const ValuePtr& left, const ValuePtr& right) {
+    if (left->getType() != right->getType()) {
+        return ValuePtr::boolean(false);
+    } else if (left->isType(ValueType::BUILTIN) ||
+               left->isType(ValueType::LAMBDA)) {
+        throw LispError("Cannot compare procedures.");
     }
-    if (std::floor(params[0]->asNumber().value()) != params[0]->asNumber().value()) {
-        throw LispError("Cannot compare a non-integer value.");
+    // Hash tables share this definition, see equalValues.
+    return ValuePtr::boolean(equalValues(left, right));
+}
+
+ValuePtr builtins::notVal(const ValuePtr& value) {
+    return ValuePtr::boolean(!value->asBoolean());
+}
+
+ValuePtr builtins::eqVal(const ValuePtr& left, const ValuePtr& right) {
+    return ValuePtr::boolean(numbers::compare(left, right) == 0);
+}
+
+ValuePtr builtins::ltVal(const ValuePtr& left, const ValuePtr& right) {
+    return ValuePtr::boolean(numbers::compare(left, right) < 0);
+}
+
+ValuePtr builtins::gtVal(const ValuePtr& left, const ValuePtr& right) {
+    return ValuePtr::boolean(numbers::compare(left, right) > 0);
+}
+
+ValuePtr builtins::leVal(const ValuePtr& left, const ValuePtr& right) {
+    return ValuePtr::boolean(numbers::compare(left, right) <= 0);
+}
+
+ValuePtr builtins::geVal(const ValuePtr& left, const ValuePtr& right) {
+    return ValuePtr::boolean(numbers::compare(left, right) >= 0);
+}
+
+ValuePtr builtins::isEven(const ValuePtr& value) {
+    if (!numbers::isInteger(value)) {
+        throw LispError("Even? requires an integer.");
     }
-    return std::make_shared<BooleanValue>(static_cast<int>(std::abs(params[0]->asNumber().value())) % 2 == 1);
+    return ValuePtr::boolean(numbers::isEven(value));
 }
 
-ValuePtr builtins::isZero(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    if (params.size() != 1) {
-        throw LispError("Zero? requires one argument.");
+ValuePtr builtins::isOdd(const ValuePtr& value) {
+    if (!numbers::isInteger(value)) {
+        throw LispError("Odd? requires an integer.");
     }
-    if (!params[0]->isType(ValueType::NUMERIC)) {
-        throw LispError("Cannot compare a non-numeric value.");
+    return ValuePtr::boolean(!numbers::isEven(value));
+}
+
+ValuePtr builtins::isZero(const ValuePtr& value) {
+    return ValuePtr::boolean(numbers::isZero(value));
+}
+
+
+// string library
+
+std::unordered_map<std::string, ValuePtr> builtins::string_builtins = {
+
+    {"string-append", makeValue<BuiltinProcValue>(&builtins::stringAppend)},
+    {"string-length", fixed<&builtins::stringLength, param::String>("string-length")},
+    {"number->string", fixed<&builtins::numberToString, param::Number>("number->string")},
+
+};
+
+ValuePtr builtins::stringAppend(Arguments params, EvalEnv& env) {
+    std::string result;
+    for (const auto& i : params) {
+        if (!i->isType(ValueType::STRING)) {
+            throw LispError("Cannot append a non-string value.");
+        }
+        result += i->asString().value();
     }
-    return std::make_shared<BooleanValue>(params[0]->asNumber().value() == 0);
+    return makeValue<StringValue>(result);
+}
+
+ValuePtr builtins::stringLength(const ValuePtr& string) {
+    return ValuePtr::integer(static_cast<StringValue*>(string.get())->getValue().size());
+}
+
+ValuePtr builtins::numberToString(const ValuePtr& number) {
+    return makeValue<StringValue>(number->toString());
 }
@@ -4,85 +4,179 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <utility>
 
 #include "./value.h"
 
 namespace builtins {
 
-void init();
+/**Fixed-arity builtins
+ * A builtin that always takes the same arguments is written as a plain
+ * function of them, such as `ValuePtr car(const ValuePtr& pair)`, and
+ * registered with fixed<&car, param::Pair>("car"). The parameter types
+ * are checked in order before the function runs, and a wrong type fails
+ * with "Car requires a pair.". A variadic function may be given as well,
+ * for the calls with another number of arguments.
+ */
+namespace param {
+
+struct Any {
+    static constexpr const char* expected = "a value";
+    static bool accepts(const ValuePtr&) { return true; }
+};
+
+struct Number {
+    static constexpr const char* expected = "a number";
+    static bool accepts(const ValuePtr& value) { return value->isType(ValueType::NUMERIC); }
+};
+
+struct Pair {
+    static constexpr const char* expected = "a pair";
+    static bool accepts(const ValuePtr& value) { return value->isType(ValueType::PAIR); }
+};
+
+struct List {
+    static constexpr const char* expected = "a list";
+    static bool accepts(const ValuePtr& value) {
+        return value->isType(ValueType::PAIR) || value->isType(ValueType::NIL);
+    }
+};
+
+struct String {
+    static constexpr const char* expected = "a string";
+    static bool accepts(const ValuePtr& value) { return value->isType(ValueType::STRING); }
+};
+
+struct Vector {
+    static constexpr const char* expected = "a vector";
+    static bool accepts(const ValuePtr& value) { return value->isType(ValueType::VECTOR); }
+};
+
+struct HashTable {
+    static constexpr const char* expected = "a hash table";
+    static bool accepts(const ValuePtr& value) { return value->isType(ValueType::HASH_TABLE); }
+};
+
+}
+
+template <auto Function, typename... Params, size_t... I>
+ValuePtr invokeFixed(const BuiltinProcValue& self, const ValuePtr* args, std::index_sequence<I...>) {
+    ((Params::accepts(args[I]) ? void() : self.fail(Params::expected)), ...);
+    return Function(args[I]...);
+}
+
+template <auto Function, typename... Params>
+ValuePtr fixedEntry(const BuiltinProcValue& self, const ValuePtr* args) {
+    return invokeFixed<Function, Params...>(self, args, std::index_sequence_for<Params...>{});
+}
+
+template <auto Function, typename... Params>
+ValuePtr fixed(std::string_view name, BuiltinProcValue::BuiltinFuncType* variadic = nullptr) {
+    static_assert(sizeof...(Params) <= BuiltinProcValue::MAX_FIXED_ARITY);
+    return makeValue<BuiltinProcValue>(name, sizeof...(Params), &fixedEntry<Function, Params...>, variadic);
+}
 
 // core library
-extern std::unordered_map<std::string, std::shared_ptr<BuiltinProcValue> > core_builtins;
-
-ValuePtr apply(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr display(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr displayln(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr error(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr eval(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr exit(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr newline(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr print(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr readline(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr help(const std::vector<ValuePtr>& params, EvalEnv& env);
+extern std::unordered_map<std::string, ValuePtr> core_builtins;
+
+ValuePtr apply(Arguments params, EvalEnv& env);
+ValuePtr display(Arguments params, EvalEnv& env);
+ValuePtr displayln(Arguments params, EvalEnv& env);
+ValuePtr error(Arguments params, EvalEnv& env);
+ValuePtr eval(Arguments params, EvalEnv& env);
+ValuePtr exit(Arguments params, EvalEnv& env);
+ValuePtr newline(Arguments params, EvalEnv& env);
+ValuePtr print(Arguments params, EvalEnv& env);
+ValuePtr readline(Arguments params, EvalEnv& env);
+ValuePtr help(Arguments params, EvalEnv& env);
+ValuePtr saveImage(Arguments params, EvalEnv& env);
 
 // type checking library
-extern std::unordered_map<std::string, std::shared_ptr<BuiltinProcValue> > type_checking_builtins;
-
-ValuePtr isAtom(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr isBoolean(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr isInteger(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr isList(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr isNumber(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr isNull(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr isPair(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr isProcedure(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr isString(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr isSymbol(const std::vector<ValuePtr>& params, EvalEnv& env);
+extern std::unordered_map<std::string, ValuePtr> type_checking_builtins;
+
+ValuePtr isAtom(const ValuePtr& value);
+ValuePtr isBoolean(const ValuePtr& value);
+ValuePtr isInteger(const ValuePtr& value);
+ValuePtr isList(const ValuePtr& value);
+ValuePtr isNumber(const ValuePtr& value);
+ValuePtr isNull(const ValuePtr& value);
+ValuePtr isPair(const ValuePtr& value);
+ValuePtr isProcedure(const ValuePtr& value);
+ValuePtr isString(const ValuePtr& value);
+ValuePtr isSymbol(const ValuePtr& value);
+ValuePtr isVector(const ValuePtr& value);
 
 // cons_list library
 
-extern std::unordered_map<std::string, std::shared_ptr<BuiltinProcValue> > cons_list_builtins;
-
-ValuePtr car(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr cdr(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr cons(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr length(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr list(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr append(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr map(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr filter(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr reduce(const std::vector<ValuePtr>& params, EvalEnv& env);
+extern std::unordered_map<std::string, ValuePtr> cons_list_builtins;
+
+ValuePtr car(const ValuePtr& pair);
+ValuePtr cdr(const ValuePtr& pair);
+ValuePtr cons(const ValuePtr& car, const ValuePtr& cdr);
+ValuePtr length(const ValuePtr& list);
+ValuePtr list(Arguments params, EvalEnv& env);
+ValuePtr append(Arguments params, EvalEnv& env);
+ValuePtr map(Arguments params, EvalEnv& env);
+ValuePtr filter(Arguments params, EvalEnv& env);
+ValuePtr reduce(Arguments params, EvalEnv& env);
+
+// vector library
+extern std::unordered_map<std::string, ValuePtr> vector_builtins;
+
+ValuePtr makeVector(Arguments params, EvalEnv& env);
+ValuePtr vector(Arguments params, EvalEnv& env);
+ValuePtr vectorRef(const ValuePtr& vector, const ValuePtr& index);
+ValuePtr vectorSet(const ValuePtr& vector, const ValuePtr& index, const ValuePtr& value);
+ValuePtr vectorLength(const ValuePtr& vector);
+ValuePtr vectorToList(Arguments params, EvalEnv& env);
+ValuePtr listToVector(Arguments params, EvalEnv& env);
+ValuePtr vectorMap(Arguments params, EvalEnv& env);
+ValuePtr vectorFill(Arguments params, EvalEnv& env);
+
+// hash table library
+extern std::unordered_map<std::string, ValuePtr> hash_table_builtins;
+
+ValuePtr makeHashTable(Arguments params, EvalEnv& env);
+ValuePtr hashRef(Arguments params, EvalEnv& env);
+ValuePtr hashSet(const ValuePtr& table, const ValuePtr& key, const ValuePtr& value);
+ValuePtr hashRemove(const ValuePtr& table, const ValuePtr& key);
+ValuePtr hashCount(const ValuePtr& table);
+ValuePtr hashKeys(Arguments params, EvalEnv& env);
+ValuePtr hashForEach(Arguments params, EvalEnv& env);
 
 // math library
-extern std::unordered_map<std::string, std::shared_ptr<BuiltinProcValue> > math_builtins;
-
-ValuePtr addVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr subVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr mulVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr divVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr absVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr exptVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr quotientVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr remainderVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr moduloVal(const std::vector<ValuePtr>& params, EvalEnv& env);
+extern std::unordered_map<std::string, ValuePtr> math_builtins;
+
+ValuePtr addVal(Arguments params, EvalEnv& env);
+ValuePtr subVal(Arguments params, EvalEnv& env);
+ValuePtr mulVal(Arguments params, EvalEnv& env);
+ValuePtr divVal(Arguments params, EvalEnv& env);
 
 // comparison library
-extern std::unordered_map<std::string, std::shared_ptr<BuiltinProcValue> > comparison_builtins;
-
-ValuePtr dataEq(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr dataEqual(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr notVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr eqVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr ltVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr gtVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr leVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr geVal(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr isEven(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr isOdd(const std::vector<ValuePtr>& params, EvalEnv& env);
-ValuePtr isZero(const std::vector<ValuePtr>& params, EvalEnv& env);
-
-// builtin library
-extern std::unordered_map<std::string, std::shared_ptr<BuiltinProcValue> > builtins;
+extern std::unordered_map<std::string, ValuePtr> comparison_builtins;
+
+ValuePtr dataEq(const ValuePtr& left, const ValuePtr& right);
+ValuePtr dataEqual(const ValuePtr& left, const ValuePtr& right);
+ValuePtr notVal(const ValuePtr& value);
+ValuePtr eqVal(const ValuePtr& left, const ValuePtr& right);
+ValuePtr ltVal(const ValuePtr& left, const ValuePtr& right);
+ValuePtr gtVal(const ValuePtr& left, const ValuePtr& right);
+ValuePtr leVal(const ValuePtr& left, const ValuePtr& right);
+ValuePtr geVal(const ValuePtr& left, const ValuePtr& right);
+ValuePtr isEven(const ValuePtr& value);
+ValuePtr isOdd(const ValuePtr& value);
+ValuePtr isZero(const ValuePtr& value);
+
+// string library
+extern std::unordered_map<std::string, ValuePtr> string_builtins;
+
+ValuePtr stringAppend(Arguments params, EvalEnv& env);
+ValuePtr stringLength(const ValuePtr& string);
+ValuePtr numberToString(const ValuePtr& number);
+
+// The frame below the global one, shared by every environment. It is built
+// from the libraries above on first use and never modified afterwards.
+const std::unordered_map<Symbol, ValuePtr>& frame();
 
 }
 
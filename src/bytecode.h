@@ -0,0 +1,85 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "./eval_env.h"
+#include "./value.h"
+
+/**Instruction set of the virtual machine
+ * Every instruction is one opcode byte followed by its operands. Slot,
+ * constant, name, global, capture and argument-count operands are 16 bits wide,
+ * jump targets are absolute 32-bit code offsets.
+ */
+enum class OpCode : uint8_t {
+    CONST,              // const          push constants[const]
+    POP,                //                drop the top of the stack
+    LOCAL_LOAD,         // slot           push frame slot
+    LOCAL_STORE,        // slot           pop into frame slot
+    BOX_LOAD,           // slot, name     push the contents of the box in a frame slot
+    BOX_STORE,          // slot           pop into the box in a frame slot
+    MAKE_BOX,           // slot           put a fresh unbound box into a frame slot
+    BOX,                // slot           wrap the value of a frame slot into a box
+    CAPTURE_LOAD,       // index          push a captured value of the running closure
+    CAPTURE_BOX_LOAD,   // index, name    push the contents of a captured box
+    GLOBAL_LOAD,        // global         push a global binding
+    GLOBAL_DEFINE,      // global         pop into a global binding, push nil
+    JUMP,               // target
+    JUMP_IF_FALSE,      // target         pop, jump if false
+    JUMP_IF_FALSE_KEEP, // target         jump keeping the top if false, pop otherwise
+    JUMP_IF_TRUE_KEEP,  // target         jump keeping the top if true, pop otherwise
+    CALL,               // argc           call [proc, args...] on the top of the stack
+    TAIL_CALL,          // argc           same, replacing the running frame
+    RETURN,             //                return the top of the stack
+    CLOSURE,            // prototype      create a closure, filling its captures
+    CONS,               //                pop cdr and car, push a new pair
+    FAIL,               // const          throw a LispError with a string constant as message
+};
+
+class Prototype;
+using PrototypePtr = std::shared_ptr<const Prototype>;
+
+/**Prototype class
+ * The compiled, immutable code of one lambda (or of one top-level form).
+ * Closures share their prototype and only own the captured values. Its
+ * global references remember their cells, which is not part of the code.
+ */
+class Prototype {
+public:
+    struct Capture {
+        bool fromLocal;     // slot of the enclosing frame, or capture of the enclosing closure
+        uint16_t index;
+        Symbol name;
+    };
+
+    size_t numParams = 0;
+    size_t numSlots = 0;
+    std::vector<uint8_t> code;
+    std::vector<ValuePtr> constants;
+    std::vector<Symbol> names;
+    mutable std::vector<GlobalReference> globals;
+    std::vector<PrototypePtr> prototypes;
+    std::vector<Capture> captures;
+    ValuePtr source;    // (params . body) of a lambda
+
+    // A prototype restored from an image has only its source and captures,
+    // and no code until its first call compiles this one in its place.
+    mutable PrototypePtr compiled;
+};
+
+inline uint16_t readU16(const uint8_t* ip) {
+    uint16_t result;
+    std::memcpy(&result, ip, sizeof(result));
+    return result;
+}
+
+inline uint32_t readU32(const uint8_t* ip) {
+    uint32_t result;
+    std::memcpy(&result, ip, sizeof(result));
+    return result;
+}
+
+#endif
@@ -0,0 +1,520 @@
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#include "./analyzer.h"
+#include "./compiler.h"
+#include "./error.h"
+
+bool hasUnquote(const ValuePtr& arg) {
+    if (!arg->isType(ValueType::PAIR)) {
+        return false;
+    }
+    auto pair = static_cast<PairValue*>(arg.get());
+    if (auto symbol = pair->getCar()->asSymbol(); symbol == symbols::UNQUOTE || symbol == symbols::UNQUOTE_COMMA) {
+        return true;
+    }
+    return hasUnquote(pair->getCar()) || hasUnquote(pair->getCdr());
+}
+
+Compiler::Compiler(Compiler* parent) : parent{parent}, proto{std::make_shared<Prototype>()} {}
+
+PrototypePtr Compiler::compileTopLevel(const ValuePtr& expr) {
+    Compiler compiler(nullptr);
+    compiler.compile(expr, true);
+    compiler.emit(OpCode::RETURN);
+    return compiler.proto;
+}
+
+
+/**Scopes
+ * Blocks are the parameter list of a lambda and the bindings of each let.
+ * An empty block stack at the outermost compiler means global scope.
+ */
+std::optional<Compiler::Variable> Compiler::resolveLocal(Symbol name) const {
+    for (auto block = blocks.rbegin(); block != blocks.rend(); block++) {
+        for (auto local = block->rbegin(); local != block->rend(); local++) {
+            if (local->name == name) {
+                return Variable{VarKind::LOCAL, local->slot, local->boxed};
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+Compiler::Variable Compiler::resolve(Symbol name) {
+    if (auto local = resolveLocal(name)) {
+        return *local;
+    }
+    if (parent == nullptr) {
+        return Variable{VarKind::GLOBAL, 0, false};
+    }
+    for (size_t i = 0; i < captureInfos.size(); i++) {
+        if (captureInfos[i].name == name) {
+            return Variable{VarKind::CAPTURED, static_cast<uint16_t>(i), captureInfos[i].boxed};
+        }
+    }
+    auto outer = parent->resolve(name);
+    if (outer.kind == VarKind::GLOBAL) {
+        return outer;
+    }
+    proto->captures.push_back({outer.kind == VarKind::LOCAL, outer.index, name});
+    captureInfos.push_back({name, outer.boxed});
+    return Variable{VarKind::CAPTURED, static_cast<uint16_t>(captureInfos.size() - 1), outer.boxed};
+}
+
+void Compiler::openBlock(const std::vector<Symbol>& names, const std::vector<ValuePtr>& body) {
+    std::vector<Symbol> defines;
+    for (const auto& expr : body) {
+        collectDefines(expr, defines);
+    }
+
+    Block block;
+    for (const auto& name : names) {
+        block.push_back({name, static_cast<uint16_t>(nextSlot++), false});
+    }
+    for (const auto& name : defines) {
+        auto local = std::ranges::find_if(block, [&](const Local& l) { return l.name == name; });
+        if (local != block.end()) {
+            local->boxed = true;
+        } else {
+            block.push_back({name, static_cast<uint16_t>(nextSlot++), true});
+        }
+    }
+    if (nextSlot > std::numeric_limits<uint16_t>::max()) {
+        throw LispError("Too many local variables.");
+    }
+    proto->numSlots = std::max(proto->numSlots, nextSlot);
+
+    // Bound names are already initialized when the block opens; the rest
+    // get an empty box that their define fills in.
+    for (size_t i = 0; i < block.size(); i++) {
+        if (block[i].boxed) {
+            emitU16(i < names.size() ? OpCode::BOX : OpCode::MAKE_BOX, block[i].slot);
+        }
+    }
+    blocks.push_back(std::move(block));
+}
+
+void Compiler::closeBlock() {
+    nextSlot -= blocks.back().size();
+    blocks.pop_back();
+}
+
+
+/**Code emission
+ */
+void Compiler::emit(OpCode op) {
+    proto->code.push_back(static_cast<uint8_t>(op));
+}
+
+void Compiler::emitU16(OpCode op, size_t operand) {
+    if (operand > std::numeric_limits<uint16_t>::max()) {
+        throw LispError("Form is too large to compile.");
+    }
+    emit(op);
+    emitOperand(static_cast<uint16_t>(operand));
+}
+
+void Compiler::emitOperand(uint16_t operand) {
+    auto bytes = reinterpret_cast<const uint8_t*>(&operand);
+    proto->code.insert(proto->code.end(), bytes, bytes + sizeof(operand));
+}
+
+size_t Compiler::emitJump(OpCode op) {
+    emit(op);
+    size_t position = proto->code.size();
+    proto->code.insert(proto->code.end(), sizeof(uint32_t), 0);
+    return position;
+}
+
+void Compiler::patchJump(size_t position) {
+    auto target = static_cast<uint32_t>(proto->code.size());
+    std::memcpy(proto->code.data() + position, &target, sizeof(target));
+}
+
+uint16_t Compiler::addConstant(ValuePtr value) {
+    proto->constants.push_back(value);
+    if (proto->constants.size() > std::numeric_limits<uint16_t>::max()) {
+        throw LispError("Form is too large to compile.");
+    }
+    return static_cast<uint16_t>(proto->constants.size() - 1);
+}
+
+uint16_t Compiler::addName(Symbol name) {
+    auto found = std::ranges::find(proto->names, name);
+    if (found != proto->names.end()) {
+        return static_cast<uint16_t>(found - proto->names.begin());
+    }
+    proto->names.push_back(name);
+    if (proto->names.size() > std::numeric_limits<uint16_t>::max()) {
+        throw LispError("Form is too large to compile.");
+    }
+    return static_cast<uint16_t>(proto->names.size() - 1);
+}
+
+uint16_t Compiler::addGlobal(Symbol name) {
+    auto found = std::ranges::find(proto->globals, name, &GlobalReference::getName);
+    if (found != proto->globals.end()) {
+        return static_cast<uint16_t>(found - proto->globals.begin());
+    }
+    proto->globals.emplace_back(name);
+    if (proto->globals.size() > std::numeric_limits<uint16_t>::max()) {
+        throw LispError("Form is too large to compile.");
+    }
+    return static_cast<uint16_t>(proto->globals.size() - 1);
+}
+
+
+/**Expressions
+ */
+const std::unordered_map<Symbol, Compiler::CompileFormType> Compiler::COMPILE_FORMS = {
+
+    {Symbol::intern("define"), &Compiler::compileDefine},
+    {Symbol::intern("quote"), &Compiler::compileQuote},
+    {Symbol::intern("quasiquote"), &Compiler::compileQuasiquoteForm},
+    {Symbol::intern("if"), &Compiler::compileIf},
+    {Symbol::intern("and"), &Compiler::compileAnd},
+    {Symbol::intern("or"), &Compiler::compileOr},
+    {Symbol::intern("lambda"), &Compiler::compileLambdaForm},
+    {Symbol::intern("cond"), &Compiler::compileCond},
+    {Symbol::intern("let"), &Compiler::compileLet},
+    {Symbol::intern("begin"), &Compiler::compileBegin},
+
+};
+
+void Compiler::compile(const ValuePtr& expr, bool tail) {
+    if (expr->isType(ValueType::BOOLEAN) ||
+        expr->isType(ValueType::NUMERIC) ||
+        expr->isType(ValueType::STRING)) {
+
+        emitU16(OpCode::CONST, addConstant(expr));
+
+    } else if (expr->isType(ValueType::NIL)) {
+
+        throw LispError("Evaluating nil is prohibited.");
+
+    } else if (expr->isType(ValueType::SYMBOL)) {
+
+        compileVariable(expr->asSymbol().value());
+
+    } else if (expr->isType(ValueType::PAIR)) {
+
+        auto pairExpr = static_cast<PairValue*>(expr.get());
+        auto head = pairExpr->getCar();
+
+        if (head->isType(ValueType::SYMBOL)) {
+            if (auto form = COMPILE_FORMS.find(head->asSymbol().value()); form != COMPILE_FORMS.end()) {
+                (this->*(form->second))(pairExpr->getCdr()->toVector(), tail);
+                return;
+            }
+        } else if (!head->isType(ValueType::PAIR)) {
+            throw LispError("Unimplemented.");
+        }
+        compileCall(head, ListView(pairExpr->getCdr()), tail);
+
+    } else {
+        throw LispError("Unimplemented.");
+    }
+}
+
+void Compiler::compileBody(const std::vector<ValuePtr>& body, bool tail) {
+    for (size_t i = 0; i < body.size(); i++) {
+        bool last = i + 1 == body.size();
+        compile(body[i], tail && last);
+        if (!last) {
+            emit(OpCode::POP);
+        }
+    }
+}
+
+void Compiler::compileBody(ListView body, bool tail) {
+    for (auto it = body.begin(); it != body.end();) {
+        const auto& expr = *it;
+        bool last = ++it == body.end();
+        compile(expr, tail && last);
+        if (!last) {
+            emit(OpCode::POP);
+        }
+    }
+}
+
+void Compiler::compileVariable(Symbol name) {
+    auto variable = resolve(name);
+    switch (variable.kind) {
+    case VarKind::LOCAL:
+        if (variable.boxed) {
+            emitU16(OpCode::BOX_LOAD, variable.index);
+            emitOperand(addName(name));
+        } else {
+            emitU16(OpCode::LOCAL_LOAD, variable.index);
+        }
+        break;
+    case VarKind::CAPTURED:
+        if (variable.boxed) {
+            emitU16(OpCode::CAPTURE_BOX_LOAD, variable.index);
+            emitOperand(addName(name));
+        } else {
+            emitU16(OpCode::CAPTURE_LOAD, variable.index);
+        }
+        break;
+    case VarKind::GLOBAL:
+        emitU16(OpCode::GLOBAL_LOAD, addGlobal(name));
+        break;
+    }
+}
+
+void Compiler::compileCall(const ValuePtr& proc, ListView args, bool tail) {
+    compile(proc, false);
+    size_t count = 0;
+    auto it = args.begin();
+    for (; it != args.end(); ++it, count++) {
+        compile(*it, false);
+    }
+    if (!it.rest()->isType(ValueType::NIL)) {
+        throw LispError("Malformed list of expressions.");
+    }
+    emitU16(tail ? OpCode::TAIL_CALL : OpCode::CALL, count);
+}
+
+void Compiler::compileLambda(const ValuePtr& params, const std::vector<ValuePtr>& body) {
+    Compiler child(this);
+    child.compileProcedure(params, body);
+    child.proto->source = makeValue<PairValue>(params, makeList(body));
+
+    proto->prototypes.push_back(child.proto);
+    emitU16(OpCode::CLOSURE, proto->prototypes.size() - 1);
+}
+
+// Compiles (lambda params body...) as the prototype of this compiler.
+void Compiler::compileProcedure(const ValuePtr& params, const std::vector<ValuePtr>& body) {
+    auto names = parameterNames(params);
+    proto->numParams = names.size();
+    openBlock(names, body);
+    compileBody(body, true);
+    emit(OpCode::RETURN);
+}
+
+// Compiled below an empty global compiler, with its captures declared up
+// front so that they keep the order the restored closures hold them in.
+PrototypePtr Compiler::compileRestored(const Prototype& restored) {
+    Compiler global(nullptr);
+    Compiler compiler(&global);
+    for (const auto& capture : restored.captures) {
+        compiler.proto->captures.push_back(capture);
+        compiler.captureInfos.push_back({capture.name, false});
+    }
+    auto source = static_cast<const PairValue*>(restored.source.get());
+    compiler.compileProcedure(source->getCar(), source->getCdr()->toVector());
+    compiler.proto->source = restored.source;
+    return compiler.proto;
+}
+
+void Compiler::compileQuasiquote(const ValuePtr& arg) {
+    if (!hasUnquote(arg)) {
+        emitU16(OpCode::CONST, addConstant(arg));
+        return;
+    }
+
+    auto pair = static_cast<PairValue*>(arg.get());
+    if (auto symbol = pair->getCar()->asSymbol(); symbol == symbols::UNQUOTE || symbol == symbols::UNQUOTE_COMMA) {
+        ListView operands(pair->getCdr());
+        if (operands.size() != 1 || !operands.isProper()) {
+            throw LispError("unquote requires exactly one argument.");
+        }
+        compile(*operands.begin(), false);
+        return;
+    }
+    compileQuasiquote(pair->getCar());
+    compileQuasiquote(pair->getCdr());
+    emit(OpCode::CONS);
+}
+
+
+/**Special forms
+ * Argument checks mirror the analyzers in forms.cpp.
+ */
+void Compiler::compileDefine(const std::vector<ValuePtr>& args, bool tail) {
+    if (args.empty()) {
+        throw LispError("define requires two argument.");
+    }
+
+    std::optional<Symbol> name;
+    if (args[0]->isType(ValueType::PAIR)) {
+        auto pair = static_cast<PairValue*>(args[0].get());
+        name = Symbol::intern(pair->getCar()->toString());
+        compileLambda(pair->getCdr(), {args.begin() + 1, args.end()});
+    } else {
+        if (args.size() < 2) {
+            throw LispError("define requires exactly two arguments.");
+        }
+        if (auto symbol = args[0]->asSymbol()) {
+            name = *symbol;
+        } else {
+            throw LispError("Unimplemented.");
+        }
+        compile(args[1], false);
+    }
+
+    if (blocks.empty() && parent == nullptr) {
+        emitU16(OpCode::GLOBAL_DEFINE, addGlobal(*name));
+        return;
+    }
+    auto local = resolveLocal(*name);
+    if (!local) {
+        throw LispError("Cannot define " + name->name() + " here.");
+    }
+    emitU16(local->boxed ? OpCode::BOX_STORE : OpCode::LOCAL_STORE, local->index);
+    emitU16(OpCode::CONST, addConstant(ValuePtr::nil()));
+}
+
+void Compiler::compileQuote(const std::vector<ValuePtr>& args, bool tail) {
+    if (args.size() != 1) {
+        throw LispError("quote requires exactly one argument.");
+    }
+    emitU16(OpCode::CONST, addConstant(args[0]));
+}
+
+void Compiler::compileQuasiquoteForm(const std::vector<ValuePtr>& args, bool tail) {
+    if (args.size() != 1) {
+        throw LispError("quasiquote requires exactly one argument.");
+    }
+    compileQuasiquote(args[0]);
+}
+
+void Compiler::compileIf(const std::vector<ValuePtr>& args, bool tail) {
+    if (args.size() != 2 && args.size() != 3) {
+        throw LispError("if requires exactly two or three arguments.");
+    }
+
+    compile(args[0], false);
+    auto elseJump = emitJump(OpCode::JUMP_IF_FALSE);
+    compile(args[1], tail);
+    auto endJump = emitJump(OpCode::JUMP);
+    patchJump(elseJump);
+    if (args.size() == 3) {
+        compile(args[2], tail);
+    } else {
+        emitU16(OpCode::CONST, addConstant(ValuePtr::nil()));
+    }
+    patchJump(endJump);
+}
+
+void Compiler::compileAnd(const std::vector<ValuePtr>& args, bool tail) {
+    if (args.empty()) {
+        emitU16(OpCode::CONST, addConstant(ValuePtr::boolean(true)));
+        return;
+    }
+    if (args.size() < 2) {
+        throw LispError("and requires at least two arguments.");
+    }
+
+    std::vector<size_t> endJumps;
+    for (size_t i = 0; i + 1 < args.size(); i++) {
+        compile(args[i], false);
+        endJumps.push_back(emitJump(OpCode::JUMP_IF_FALSE_KEEP));
+    }
+    compile(args.back(), tail);
+    for (auto jump : endJumps) {
+        patchJump(jump);
+    }
+}
+
+void Compiler::compileOr(const std::vector<ValuePtr>& args, bool tail) {
+    if (args.empty()) {
+        emitU16(OpCode::CONST, addConstant(ValuePtr::boolean(false)));
+        return;
+    }
+    if (args.size() < 2) {
+        throw LispError("and requires at least two arguments.");
+    }
+
+    std::vector<size_t> endJumps;
+    for (size_t i = 0; i + 1 < args.size(); i++) {
+        compile(args[i], false);
+        endJumps.push_back(emitJump(OpCode::JUMP_IF_TRUE_KEEP));
+    }
+    compile(args.back(), tail);
+    for (auto jump : endJumps) {
+        patchJump(jump);
+    }
+}
+
+void Compiler::compileLambdaForm(const std::vector<ValuePtr>& args, bool tail) {
+    if (args.size() < 2) {
+        throw LispError("lambda requires at least two arguments.");
+    }
+    compileLambda(args[0], {args.begin() + 1, args.end()});
+}
+
+void Compiler::compileCond(const std::vector<ValuePtr>& args, bool tail) {
+    std::vector<size_t> endJumps;
+    bool hasElse = false;
+    for (const auto& p : args) {
+        if (!p->isType(ValueType::PAIR)) {
+            throw LispError("empty clause in cond.");
+        }
+        auto clause = static_cast<PairValue*>(p.get());
+        const auto& test = clause->getCar();
+        ListView body(clause->getCdr());
+
+        if (test->asSymbol() == symbols::ELSE) {
+            if (&p != &args.back()) {
+                throw LispError("else clause is not the last clause in cond.");
+            }
+            if (body.empty()) {
+                throw LispError("there must be expressions after else.");
+            }
+            compileBody(body, tail);
+            hasElse = true;
+        } else if (body.empty()) {
+            compile(test, false);
+            endJumps.push_back(emitJump(OpCode::JUMP_IF_TRUE_KEEP));
+        } else {
+            compile(test, false);
+            auto nextJump = emitJump(OpCode::JUMP_IF_FALSE);
+            compileBody(body, tail);
+            endJumps.push_back(emitJump(OpCode::JUMP));
+            patchJump(nextJump);
+        }
+    }
+    if (!hasElse) {
+        emitU16(OpCode::FAIL, addConstant(makeValue<StringValue>("No true clause in cond.")));
+    }
+    for (auto jump : endJumps) {
+        patchJump(jump);
+    }
+}
+
+void Compiler::compileLet(const std::vector<ValuePtr>& args, bool tail) {
+    if (args.size() < 2) {
+        throw LispError("Let form requires at least two arguments.");
+    }
+
+    std::vector<Symbol> identifiers;
+    for (const auto& binding : ListView(args[0])) {
+        ListView pair(binding);
+        if (pair.size() != 2 || !pair.isProper() || !(*pair.begin())->isType(ValueType::SYMBOL)) {
+            throw LispError("Invalid binding in let form.");
+        }
+        identifiers.push_back((*pair.begin())->asSymbol().value());
+        compile(*std::ranges::next(pair.begin()), false);
+    }
+
+    std::vector<ValuePtr> body{args.begin() + 1, args.end()};
+    auto first = static_cast<uint16_t>(nextSlot);
+    for (size_t i = identifiers.size(); i > 0; i--) {
+        emitU16(OpCode::LOCAL_STORE, first + i - 1);
+    }
+    openBlock(identifiers, body);
+    compileBody(body, tail);
+    closeBlock();
+}
+
+void Compiler::compileBegin(const std::vector<ValuePtr>& args, bool tail) {
+    if (args.empty()) {
+        emitU16(OpCode::CONST, addConstant(ValuePtr::nil()));
+        return;
+    }
+    compileBody(args, tail);
+}
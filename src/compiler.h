@@ -0,0 +1,93 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "./bytecode.h"
+#include "./value.h"
+
+/**Compiler class
+ * Translates parsed forms into bytecode prototypes for the VM.
+ * Parameters, let bindings and internal defines live in numbered frame
+ * slots; lambdas copy the variables they use from enclosing frames into
+ * their closure. Since only define can rebind a variable, names that are
+ * the target of an internal define are kept in boxes so every closure
+ * sharing them sees the rebinding.
+ */
+class Compiler {
+    struct Local {
+        Symbol name;
+        uint16_t slot;
+        bool boxed;
+    };
+    using Block = std::vector<Local>;
+
+    struct CaptureInfo {
+        Symbol name;
+        bool boxed;
+    };
+
+    enum class VarKind { LOCAL, CAPTURED, GLOBAL };
+    struct Variable {
+        VarKind kind;
+        uint16_t index;
+        bool boxed;
+    };
+
+    using CompileFormType = void (Compiler::*)(const std::vector<ValuePtr>&, bool);
+    static const std::unordered_map<Symbol, CompileFormType> COMPILE_FORMS;
+
+    Compiler* parent;
+    std::shared_ptr<Prototype> proto;
+    std::vector<Block> blocks;
+    std::vector<CaptureInfo> captureInfos;
+    size_t nextSlot = 0;
+
+    Compiler(Compiler* parent);
+
+    std::optional<Variable> resolveLocal(Symbol name) const;
+    Variable resolve(Symbol name);
+
+    void openBlock(const std::vector<Symbol>& names, const std::vector<ValuePtr>& body);
+    void closeBlock();
+
+    void emit(OpCode op);
+    void emitU16(OpCode op, size_t operand);
+    void emitOperand(uint16_t operand);
+    size_t emitJump(OpCode op);
+    void patchJump(size_t position);
+    uint16_t addConstant(ValuePtr value);
+    uint16_t addName(Symbol name);
+    uint16_t addGlobal(Symbol name);
+
+    void compile(const ValuePtr& expr, bool tail);
+    void compileBody(const std::vector<ValuePtr>& body, bool tail);
+    void compileBody(ListView body, bool tail);
+    void compileVariable(Symbol name);
+    void compileCall(const ValuePtr& proc, ListView args, bool tail);
+    void compileQuasiquote(const ValuePtr& arg);
+    void compileLambda(const ValuePtr& params, const std::vector<ValuePtr>& body);
+    void compileProcedure(const ValuePtr& params, const std::vector<ValuePtr>& body);
+
+    void compileDefine(const std::vector<ValuePtr>& args, bool tail);
+    void compileQuote(const std::vector<ValuePtr>& args, bool tail);
+    void compileQuasiquoteForm(const std::vector<ValuePtr>& args, bool tail);
+    void compileIf(const std::vector<ValuePtr>& args, bool tail);
+    void compileAnd(const std::vector<ValuePtr>& args, bool tail);
+    void compileOr(const std::vector<ValuePtr>& args, bool tail);
+    void compileLambdaForm(const std::vector<ValuePtr>& args, bool tail);
+    void compileCond(const std::vector<ValuePtr>& args, bool tail);
+    void compileLet(const std::vector<ValuePtr>& args, bool tail);
+    void compileBegin(const std::vector<ValuePtr>& args, bool tail);
+
+public:
+    static PrototypePtr compileTopLevel(const ValuePtr& expr);
+    // The code of a prototype restored from an image, which has only its
+    // source and captures.
+    static PrototypePtr compileRestored(const Prototype& restored);
+};
+
+#endif
@@ -1,134 +1,66 @@
+#include "./analyzer.h"
 #include "./builtins.h"
 #include "./error.h"
 #include "./eval_env.h"
-#include "./forms.h"
 
-EvalEnv::EvalEnv() : parent{nullptr} {
-    builtins::init();
-    for (const auto& [name, value] : builtins::builtins) {
-        define(name, value);
+ValuePtr* ValueStack::frame(size_t base, const Scope& scope) {
+    if (values.size() - base != scope.numParams) {
+        throw LispError("Parameter size and argument size do not match.");
     }
-}
-EvalEnv::EvalEnv(std::shared_ptr<EvalEnv> parent = std::make_shared<EvalEnv>(nullptr)) : parent{parent} {
-    builtins::init();
-    for (const auto& [name, value] : builtins::builtins) {
-        define(name, value);
+    reserve(scope.names.size() - scope.numParams);
+    values.resize(base + scope.names.size());
+    ValuePtr* slots = values.data() + base;
+    for (auto slot : scope.boxes) {
+        slots[slot] = makeValue<BoxValue>(std::move(slots[slot]));
     }
+    return slots;
 }
 
-void EvalEnv::define(const std::string& symbol, ValuePtr value) {
-    SYMBOL_TABLE[symbol] = value;
+EvalEnv::EvalEnv() : serial{++globalFrames}, parent{nullptr}, global{this} {}
+EvalEnv::EvalEnv(EvalEnv& parent, ScopePtr scope, size_t base, Arguments captures) :
+    slots{ValueStack::frame(base, *scope)}, captures{captures}, scope{std::move(scope)},
+    parent{&parent}, global{parent.global} {}
+
+// The cell of a name is made on its first use, holding the builtin of
+// that name if there is one.
+GlobalCell& EvalEnv::cell(Symbol symbol) {
+    auto& table = global->SYMBOL_TABLE;
+    if (auto cell = table.find(symbol); cell != table.end()) {
+        return cell->second;
+    }
+    GlobalCell cell;
+    if (auto builtin = builtins::frame().find(symbol); builtin != builtins::frame().end()) {
+        cell.value = builtin->second;
+    }
+    return table.emplace(symbol, std::move(cell)).first->second;
 }
 
-ValuePtr EvalEnv::lookup(const std::string& symbol) {
-    if (auto value = SYMBOL_TABLE.find(symbol); value != SYMBOL_TABLE.end()) {
-        return value->second;
-    } else if (parent != nullptr) {
-        return parent->lookup(symbol);
-    } else {
-        throw LispError("Unfound symbol: " + symbol);
-        return (ValuePtr)nullptr;
-    }
+void EvalEnv::define(Symbol symbol, ValuePtr value) {
+    GlobalReference(symbol).define(*this, std::move(value));
 }
 
-bool isSelfEvaluating(ValuePtr expr) {
-    return expr->isType(ValueType::BOOLEAN) || 
-           expr->isType(ValueType::NUMERIC) || 
-           expr->isType(ValueType::STRING);
+ValuePtr EvalEnv::lookup(Symbol symbol) {
+    return GlobalReference(symbol).load(*this);
 }
 
-std::shared_ptr<EvalEnv> EvalEnv::createChild(const std::vector<std::string>& params, const std::vector<ValuePtr>& args) {
-    if (params.size() != args.size()) {
-        throw LispError("Parameter size and argument size do not match.");
-    }
-    auto child = std::make_shared<EvalEnv>(shared_from_this());
-    for (size_t i = 0; i < params.size(); i++) {
-        child->define(params[i], args[i]);
+std::vector<std::pair<Symbol, ValuePtr>> EvalEnv::globals() const {
+    std::vector<std::pair<Symbol, ValuePtr>> result;
+    for (const auto& [name, cell] : global->SYMBOL_TABLE) {
+        if (cell.defined) {
+            result.emplace_back(name, cell.value);
+        }
     }
-    return child;
+    return result;
 }
 
-ValuePtr EvalEnv::apply(ValuePtr proc, std::vector<ValuePtr> args) {
-    if (proc->isType(ValueType::BUILTIN)) {
-        return static_cast<BuiltinProcValue*>(proc.get())->call(args, *this);
-    } if (proc->isType(ValueType::LAMBDA)) {
-        return static_cast<LambdaValue*>(proc.get())->call(args, *this);
+ValuePtr EvalEnv::apply(const ValuePtr& proc, Arguments args) {
+    if (proc->isType(ValueType::BUILTIN) || proc->isType(ValueType::LAMBDA)) {
+        return proc->call(args, *this);
     } else {
         throw LispError("Unimplemented");
     }
 }
 
 ValuePtr EvalEnv::eval(ValuePtr expr) {
-    if (isSelfEvaluating(expr)) {
-
-        return expr;
-
-    } else if (expr->isType(ValueType::NIL)) {
-
-        throw LispError("Evaluating nil is prohibited.");
-
-    } else if (expr->isType(ValueType::PAIR)) {
-
-        auto pairExpr = static_cast<PairValue*>(expr.get());
-        auto exprVec = pairExpr->toVector();
-
-        if (exprVec[0]->isType(ValueType::SYMBOL)) {
-            
-            auto name = exprVec[0]->asSymbol().value();
-
-            if (auto specialForm = SPECIAL_FORMS.find(name); specialForm != SPECIAL_FORMS.end()) {
-
-                return (specialForm->second)(pairExpr->getCdr()->toVector(), *this);
-
-            } else if (auto value = lookup(name); value != nullptr) {
-
-                ValuePtr proc = eval(exprVec[0]);
-                std::vector<ValuePtr> args = evalList(pairExpr->getCdr());
-                return this->apply(proc, args);
-
-            } else {
-
-                throw LispError("Unfound symbol: " + name);
-
-            }
-
-        } else if (exprVec[0]->isType(ValueType::PAIR)) {
-        
-            ValuePtr proc = eval(exprVec[0]);
-            std::vector<ValuePtr> args = evalList(pairExpr->getCdr());
-            return this->apply(proc, args);
-
-        } else {
-
-            throw LispError("Unimplemented.");
-
-        }  
-
-    } else if (expr->isType(ValueType::SYMBOL)) {
-
-        if (auto symbol = expr->asSymbol()) {
-            if (auto value = lookup(symbol.value())) {
-                return value;
-            } else {
-                throw LispError("Variable " + symbol.value() + " not defined.");
-            }
-        }
-
-    }
-    
-    else {
-        throw LispError("Unimplemented.");
-    }
-
-    return nullptr;
-}
-
-std::vector<ValuePtr> EvalEnv::evalList(ValuePtr expr) {
-    std::vector<ValuePtr> result;
-    std::ranges::transform(
-        expr->toVector(),
-        std::back_inserter(result),
-        [this](ValuePtr value) { return this->eval(value); }
-    );
-    return result;
+    return analyze(expr, scope)->eval(*this);
 }
\ No newline at end of file
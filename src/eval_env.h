@@ -4,25 +4,205 @@
 #include <algorithm>
 #include <iterator>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "./error.h"
+#include "./scope.h"
 #include "value.h"
 
-class EvalEnv : public std::enable_shared_from_this<EvalEnv> {
-    std::unordered_map<std::string, ValuePtr> SYMBOL_TABLE;
-    std::shared_ptr<EvalEnv> parent;
+/**ValueStack class
+ * The arguments and frames of the calls the tree-walking evaluator is
+ * making. Arguments are pushed in place and passed to the callee as a
+ * span of the stack, which the callee takes over as the first slots of
+ * its frame; a let frame is made of its pushed initial values the same
+ * way. The storage is reserved once and never moves, so spans and slots
+ * stay valid while calls are made above them. A Mark pops whatever was
+ * pushed after it when it goes out of scope, errors included.
+ */
+class ValueStack {
+    static constexpr size_t CAPACITY = 1 << 20;
+
+    static inline std::vector<ValuePtr> values = [] {
+        std::vector<ValuePtr> result;
+        result.reserve(CAPACITY);
+        return result;
+    }();
+
+    static void reserve(size_t count) {
+        if (CAPACITY - values.size() < count) {
+            throw LispError("Too many nested calls.");
+        }
+    }
 
 public:
-    EvalEnv();
-    EvalEnv(std::shared_ptr<EvalEnv> parent);
+    class Mark {
+        size_t size;
+
+    public:
+        Mark() : size{values.size()} {}
+        explicit Mark(size_t size) : size{size} {}
+        Mark(const Mark&) = delete;
+        ~Mark() {
+            values.resize(size);
+        }
+    };
 
-    std::shared_ptr<EvalEnv> createChild(const std::vector<std::string>& params, const std::vector<ValuePtr>& args);
+    static size_t size() {
+        return values.size();
+    }
+    static void push(ValuePtr value) {
+        reserve(1);
+        values.push_back(std::move(value));
+    }
+    static Arguments top(size_t count) {
+        return Arguments(values.data() + values.size() - count, count);
+    }
+
+    // Where args start on the stack. Arguments passed as its top values
+    // are taken over where they are, and the caller must not use them
+    // after the call; any others are copied there.
+    static size_t adopt(Arguments args) {
+        if (args.data() + args.size() == values.data() + values.size()) {
+            return values.size() - args.size();
+        }
+        reserve(args.size());
+        size_t base = values.size();
+        values.insert(values.end(), args.begin(), args.end());
+        return base;
+    }
+
+    // Replaces the values from base up by the top count ones, for a call
+    // that takes the place of the frame at base.
+    static void replace(size_t base, size_t count) {
+        std::move(values.end() - count, values.end(), values.begin() + base);
+        values.resize(base + count);
+    }
+
+    // Completes the parameters from base up into the slots of a frame
+    // for scope.
+    static ValuePtr* frame(size_t base, const Scope& scope);
+};
 
-    ValuePtr apply(ValuePtr proc, std::vector<ValuePtr> args);
+
+/**GlobalCell struct
+ * The binding of one name in a global frame. A name that is only a builtin
+ * so far holds the builtin until the program defines it. Cells never move,
+ * so uses of a global can keep a pointer to the cell instead of looking the
+ * name up again, and a redefinition updates the cell in place.
+ */
+struct GlobalCell {
+    ValuePtr value;
+    bool defined = false;
+};
+
+
+/**EvalEnv class
+ * The global frame maps names to cells, which start out with the value of
+ * the shared builtin frame, so definitions shadow builtins without
+ * touching them.
+ * Every other frame is created for a lambda call or a let and is a flat
+ * array of slots laid out by its Scope; a null slot is a name whose define
+ * has not run yet. The frame of a lambda call sits right on the global
+ * frame and sees the captures of the closure called, which the call keeps
+ * alive.
+ *
+ * No frame outlives the call or let that creates it: closures copy what
+ * they capture, and builtins and eval only use the frame they are called
+ * from while they run. So frames are local objects of the evaluator and
+ * their slots live on the ValueStack.
+ */
+class EvalEnv {
+    static inline size_t globalFrames = 0;
+
+    std::unordered_map<Symbol, GlobalCell> SYMBOL_TABLE;
+    size_t serial = 0;
+    ValuePtr* slots = nullptr;
+    Arguments captures;
+    ScopePtr scope;
+    EvalEnv* parent;
+    EvalEnv* global;
+
+public:
+    EvalEnv();
+    // A frame for scope whose parameters are the values of the ValueStack
+    // from base up.
+    EvalEnv(EvalEnv& parent, ScopePtr scope, size_t base, Arguments captures = {});
+    EvalEnv(const EvalEnv&) = delete;
+
+    ValuePtr apply(const ValuePtr& proc, Arguments args);
     ValuePtr eval(ValuePtr expr);
-    std::vector<ValuePtr> evalList(ValuePtr expr);
 
-    void define(const std::string& symbol, ValuePtr value);
-    ValuePtr lookup(const std::string& symbol);
+    ValuePtr& slot(size_t depth, size_t index) {
+        EvalEnv* env = this;
+        for (; depth > 0; depth--) {
+            env = env->parent;
+        }
+        return env->slots[index];
+    }
+    const ValuePtr& capture(size_t depth, size_t index) {
+        EvalEnv* env = this;
+        for (; depth > 0; depth--) {
+            env = env->parent;
+        }
+        return env->captures[index];
+    }
+
+    const ScopePtr& getScope() const {
+        return scope;
+    }
+
+    // Bindings of the global frame, reachable from any frame.
+    GlobalCell& cell(Symbol symbol);
+    void define(Symbol symbol, ValuePtr value);
+    ValuePtr lookup(Symbol symbol);
+    // The names the program has defined, with their values.
+    std::vector<std::pair<Symbol, ValuePtr>> globals() const;
+    EvalEnv& globalFrame() const {
+        return *global;
+    }
+
+    friend class GlobalReference;
+};
+
+
+/**GlobalReference class
+ * A use of a global variable by analyzed or compiled code, which keeps the
+ * cell of the global frame it last ran in. Global frames are told apart by
+ * serial number, as one may be destroyed and another made at its address.
+ */
+class GlobalReference {
+    Symbol name;
+    size_t frame = 0;
+    GlobalCell* cell = nullptr;
+
+public:
+    explicit GlobalReference(Symbol name) : name{name} {}
+
+    Symbol getName() const {
+        return name;
+    }
+
+    GlobalCell& resolve(EvalEnv& env) {
+        if (frame != env.global->serial) {
+            cell = &env.global->cell(name);
+            frame = env.global->serial;
+        }
+        return *cell;
+    }
+
+    const ValuePtr& load(EvalEnv& env) {
+        if (const auto& value = resolve(env).value) {
+            return value;
+        }
+        throw LispError("Unfound symbol: " + name.name());
+    }
+
+    void define(EvalEnv& env, ValuePtr value) {
+        auto& target = resolve(env);
+        target.value = std::move(value);
+        target.defined = true;
+    }
 };
 
-#endif
\ No newline at end of file
+#endif
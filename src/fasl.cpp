@@ -0,0 +1,364 @@
+#include "./fasl.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <unordered_map>
+
+#include "./binary_io.h"
+#include "./error.h"
+#include "./number.h"
+
+namespace {
+
+constexpr char MAGIC[] = {'M', 'L', 'F', 'A', 'S', 'L', 0, 2};    // last byte is the format version
+constexpr size_t HEADER_SIZE = sizeof(MAGIC) + 2 * sizeof(uint64_t);
+constexpr size_t RELEASE_STEP = 1 << 20;
+
+enum class Tag : uint8_t {
+    NIL,
+    FALSE,
+    TRUE,
+    NUMBER,         // a flonum
+    INTEGER,        // a fixnum, zigzag encoded
+    BIGNUM,         // decimal digits
+    STRING,
+    SYMBOL,         // a new symbol, numbered in order of appearance
+    SYMBOL_REF,
+    LIST,           // element count, the elements, then the tail
+    END,
+};
+
+// Caches being written, removed if the process exits before they are
+// complete; std::exit runs this destructor but not those of Recorders.
+struct Temporaries {
+    std::set<std::string> paths;
+
+    ~Temporaries() {
+        std::error_code error;
+        for (const auto& path : paths) {
+            std::filesystem::remove(path, error);
+        }
+    }
+};
+
+Temporaries temporaries;
+
+}
+
+
+namespace fasl {
+
+class Writer : public BinaryWriter {
+    std::unordered_map<Symbol, size_t> symbols;
+
+    void tag(Tag value) {
+        byte(static_cast<uint8_t>(value));
+    }
+
+    void leaf(const ValuePtr& value) {
+        if (value->isFlonum()) {
+            tag(Tag::NUMBER);
+            real(value->asNumber().value());
+        } else if (value->isFixnum()) {
+            tag(Tag::INTEGER);
+            integer(value->getFixnum());
+        } else if (value->isType(ValueType::NUMERIC)) {
+            tag(Tag::BIGNUM);
+            bytes(value->toString());
+        } else if (value->isType(ValueType::NIL)) {
+            tag(Tag::NIL);
+        } else if (value->isType(ValueType::BOOLEAN)) {
+            tag(value->asBoolean() ? Tag::TRUE : Tag::FALSE);
+        } else if (value->isType(ValueType::STRING)) {
+            tag(Tag::STRING);
+            bytes(value->asString().value());
+        } else if (auto symbol = value->asSymbol()) {
+            auto [it, inserted] = symbols.emplace(*symbol, symbols.size());
+            if (inserted) {
+                tag(Tag::SYMBOL);
+                bytes(symbol->name());
+            } else {
+                tag(Tag::SYMBOL_REF);
+                count(it->second);
+            }
+        } else {
+            throw LispError("Cannot store " + value->toString() + " in a fasl file.");
+        }
+    }
+
+public:
+    Writer(std::ofstream& out) : BinaryWriter(out) {}
+
+    // Written in prefix order with an explicit stack, as forms may nest
+    // deeper than the native stack allows.
+    void value(const ValuePtr& root) {
+        std::vector<ValuePtr> stack{root};
+        while (!stack.empty()) {
+            ValuePtr current = std::move(stack.back());
+            stack.pop_back();
+            if (!current->isType(ValueType::PAIR)) {
+                leaf(current);
+                continue;
+            }
+            std::vector<ValuePtr> items;
+            ValuePtr tail = current;
+            while (tail->isType(ValueType::PAIR)) {
+                auto pair = static_cast<PairValue*>(tail.get());
+                items.push_back(pair->getCar());
+                tail = pair->getCdr();
+            }
+            tag(Tag::LIST);
+            count(items.size());
+            stack.push_back(std::move(tail));
+            for (auto item = items.rbegin(); item != items.rend(); ++item) {
+                stack.push_back(std::move(*item));
+            }
+        }
+    }
+
+    void end() {
+        tag(Tag::END);
+    }
+};
+
+}
+
+
+std::string fasl::defaultDirectory() {
+    std::filesystem::path base;
+    if (auto cache = std::getenv("XDG_CACHE_HOME"); cache != nullptr && *cache != '\0') {
+        base = cache;
+    } else if (auto home = std::getenv("HOME"); home != nullptr && *home != '\0') {
+        base = std::filesystem::path(home) / ".cache";
+    } else {
+        base = std::filesystem::temp_directory_path();
+    }
+    return (base / "mini-lisp").string();
+}
+
+// Named after the script and a hash of its full path, so scripts of the
+// same name in different directories do not share a cache.
+std::string fasl::cachePath(const std::string& directory, const std::string& sourcePath) {
+    std::error_code error;
+    auto absolute = std::filesystem::absolute(sourcePath, error);
+    if (error) {
+        absolute = sourcePath;
+    }
+    char id[17];
+    std::snprintf(id, sizeof(id), "%016zx", std::hash<std::string>{}(absolute.lexically_normal().string()));
+    auto name = absolute.filename().string() + "-" + id + ".fasl";
+    return (std::filesystem::path(directory) / name).string();
+}
+
+// FNV-1a, over eight bytes at a time
+uint64_t fasl::hash(MappedFile& source) {
+    auto input = source.view();
+    uint64_t result = 0xcbf29ce484222325;
+    size_t pos = 0;
+    while (pos < input.size()) {
+        size_t begin = pos;
+        size_t end = std::min(input.size(), pos + RELEASE_STEP);
+        for (; pos + sizeof(uint64_t) <= end; pos += sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, input.data() + pos, sizeof(word));
+            result = (result ^ word) * 0x100000001b3;
+        }
+        for (; pos < end; pos++) {
+            result = (result ^ static_cast<unsigned char>(input[pos])) * 0x100000001b3;
+        }
+        source.release(begin, end);
+    }
+    return result;
+}
+
+/**Recorder class
+ * Methods of writing a cache while the script is read
+ */
+// The cache is written aside and renamed into place, so that a process
+// running the same script never sees half a cache.
+fasl::Recorder::Recorder(MappedFile& source, const std::string& path) : reader{source}, path{path} {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    temporary = path + ".tmp" + std::to_string(std::random_device{}());
+    out.open(temporary, std::ios::binary);
+    if (!out) {
+        return;
+    }
+    temporaries.paths.insert(temporary);
+    uint64_t header[] = {hash(source), source.view().size()};
+    out.write(MAGIC, sizeof(MAGIC));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    writer = std::make_unique<Writer>(out);
+}
+
+fasl::Recorder::~Recorder() {
+    abandon();
+}
+
+void fasl::Recorder::abandon() {
+    if (!writer) {
+        return;
+    }
+    writer.reset();
+    out.close();
+    std::error_code error;
+    std::filesystem::remove(temporary, error);
+    temporaries.paths.erase(temporary);
+}
+
+void fasl::Recorder::finish() {
+    writer->end();
+    writer.reset();
+    out.close();
+    std::error_code error;
+    if (out) {
+        std::filesystem::rename(temporary, path, error);
+    }
+    if (!out || error) {
+        std::filesystem::remove(temporary, error);
+    }
+    temporaries.paths.erase(temporary);
+}
+
+std::optional<ValuePtr> fasl::Recorder::read() {
+    std::optional<ValuePtr> form;
+    try {
+        form = reader.read();
+    } catch (std::runtime_error&) {
+        abandon();
+        throw;
+    }
+    if (!writer) {
+        return form;
+    }
+    if (!form) {
+        finish();
+        return form;
+    }
+    try {
+        writer->value(*form);
+    } catch (std::runtime_error&) {
+        abandon();
+    }
+    return form;
+}
+
+
+/**Loader class
+ * Methods of reading forms back from a fasl file
+ */
+fasl::Loader::Loader(const std::string& path) : file{path}, input{file.view(), HEADER_SIZE} {}
+
+std::unique_ptr<fasl::Loader> fasl::Loader::open(const std::string& path, MappedFile& source) {
+    std::unique_ptr<Loader> loader;
+    try {
+        loader = std::make_unique<Loader>(path);
+    } catch (std::runtime_error&) {
+        return nullptr;
+    }
+    auto view = loader->file.view();
+    uint64_t header[2];
+    if (view.size() <= HEADER_SIZE || std::memcmp(view.data(), MAGIC, sizeof(MAGIC)) != 0 ||
+        static_cast<Tag>(view.back()) != Tag::END) {
+        return nullptr;
+    }
+    std::memcpy(header, view.data() + sizeof(MAGIC), sizeof(header));
+    if (header[1] != source.view().size() || header[0] != hash(source)) {
+        return nullptr;
+    }
+    return loader;
+}
+
+ValuePtr fasl::Loader::leaf(uint8_t tag) {
+    switch (static_cast<Tag>(tag)) {
+    case Tag::NIL:
+        return ValuePtr::nil();
+    case Tag::FALSE:
+        return ValuePtr::boolean(false);
+    case Tag::TRUE:
+        return ValuePtr::boolean(true);
+    case Tag::NUMBER:
+        return ValuePtr::number(input.real());
+    case Tag::INTEGER:
+        return ValuePtr::integer(input.integer());
+    case Tag::BIGNUM:
+        return numbers::fromLiteral(input.bytes(), 0);
+    case Tag::STRING:
+        return makeValue<StringValue>(std::string(input.bytes()));
+    case Tag::SYMBOL:
+        symbols.push_back(SymbolValue::intern(input.bytes()));
+        return symbols.back();
+    case Tag::SYMBOL_REF:
+    {
+        size_t index = input.count();
+        if (index >= symbols.size()) {
+            throw std::runtime_error("Corrupt fasl file");
+        }
+        return symbols[index];
+    }
+    default:
+        throw std::runtime_error("Corrupt fasl file");
+    }
+}
+
+// Lists still being read are kept on an explicit stack, each with its
+// elements so far and, once complete, its tail.
+ValuePtr fasl::Loader::value() {
+    struct List {
+        size_t length;
+        std::vector<ValuePtr> items;
+    };
+    std::vector<List> open;
+    while (true) {
+        uint8_t tag = input.byte();
+        if (static_cast<Tag>(tag) == Tag::LIST) {
+            size_t length = input.count();
+            if (length > file.view().size()) {
+                throw std::runtime_error("Corrupt fasl file");
+            }
+            open.push_back({length, {}});
+            open.back().items.reserve(length + 1);
+            continue;
+        }
+        ValuePtr result = leaf(tag);
+        while (true) {
+            if (open.empty()) {
+                return result;
+            }
+            auto& list = open.back();
+            list.items.push_back(std::move(result));
+            if (list.items.size() <= list.length) {
+                break;
+            }
+            result = std::move(list.items.back());
+            for (auto item = list.items.rbegin() + 1; item != list.items.rend(); ++item) {
+                result = makeValue<PairValue>(std::move(*item), std::move(result));
+            }
+            open.pop_back();
+        }
+    }
+}
+
+std::optional<ValuePtr> fasl::Loader::read() {
+    if (input.atEnd() || static_cast<Tag>(input.peek()) == Tag::END) {
+        return std::nullopt;
+    }
+    ValuePtr result;
+    try {
+        result = value();
+    } catch (std::runtime_error&) {
+        input.skipToEnd();
+        throw;
+    }
+    if (input.position() - released >= RELEASE_STEP) {
+        file.release(released, input.position());
+        released = input.position();
+    }
+    return result;
+}
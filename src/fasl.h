@@ -0,0 +1,87 @@
+#ifndef FASL_H
+#define FASL_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "./binary_io.h"
+#include "./mapped_file.h"
+#include "./reader.h"
+#include "./value.h"
+
+/**Fasl cache
+ * The forms of a script, already read, in a compact binary file kept in a
+ * cache directory. The file starts with a hash and the size of the source
+ * it was read from, and is used only while both still match, so an edited
+ * script is read from text again. Forms are stored in order, each a tree
+ * of tagged values; lists are stored flat as their elements and tail, and
+ * symbols by name once and by number after that. Numbers are stored in
+ * native byte order, as the cache never leaves the machine that wrote it.
+ */
+namespace fasl {
+
+// $XDG_CACHE_HOME/mini-lisp, or else ~/.cache/mini-lisp.
+std::string defaultDirectory();
+// The cache of the script at sourcePath, in directory.
+std::string cachePath(const std::string& directory, const std::string& sourcePath);
+
+// Hash of the file's contents; the pages read are released behind.
+uint64_t hash(MappedFile& source);
+
+class Writer;
+
+/**Recorder class
+ * Reads the forms of a script from its text one at a time, as a Reader
+ * does, and writes each to a new cache at path on the way. The cache is
+ * put in place once the whole script has been read; none is kept for a
+ * script with a syntax error, or if the process exits before the end.
+ * A cache that cannot be written leaves only the reading.
+ */
+class Recorder {
+    Reader reader;
+    std::string path;
+    std::string temporary;
+    std::ofstream out;
+    std::unique_ptr<Writer> writer;
+
+    void abandon();
+    void finish();
+
+public:
+    Recorder(MappedFile& source, const std::string& path);
+    Recorder(const Recorder&) = delete;
+    ~Recorder();
+
+    // The next form, or nothing after the last one.
+    std::optional<ValuePtr> read();
+};
+
+
+class Loader {
+    MappedFile file;
+    BinaryReader input;
+    size_t released = 0;
+    std::vector<ValuePtr> symbols;
+
+    ValuePtr leaf(uint8_t tag);
+    ValuePtr value();
+
+public:
+    Loader(const std::string& path);
+
+    // The loader for the cache at path, if it was written for source.
+    static std::unique_ptr<Loader> open(const std::string& path, MappedFile& source);
+
+    // The next form, or nothing after the last one. Reading ends after the
+    // first error.
+    std::optional<ValuePtr> read();
+};
+
+}
+
+#endif
@@ -1,26 +1,38 @@
+
 #include <algorithm>
 #include <ranges>
 
+#include "./analyzer.h"
 #include "./error.h"
-#include "./eval_env.h"
 #include "./forms.h"
 
-std::unordered_map<std::string, SpecialFormType*> SPECIAL_FORMS = {
-
-    {"define", defineForm},
-    {"quote", quoteForm},
-    {"quasiquote", quasiquoteForm},
-    {"if", ifForm},
-    {"and", andForm},
-    {"or", orForm},
-    {"lambda", lambdaForm},
-    {"cond", condForm},
-    {"let", letForm},
-    {"begin", beginForm},
-    
+std::unordered_map<Symbol, SpecialFormType*> SPECIAL_FORMS = {
+
+    {Symbol::intern("define"), defineForm},
+    {Symbol::intern("quote"), quoteForm},
+    {Symbol::intern("quasiquote"), quasiquoteForm},
+    {Symbol::intern("if"), ifForm},
+    {Symbol::intern("and"), andForm},
+    {Symbol::intern("or"), orForm},
+    {Symbol::intern("lambda"), lambdaForm},
+    {Symbol::intern("cond"), condForm},
+    {Symbol::intern("let"), letForm},
+    {Symbol::intern("begin"), beginForm},
+
 };
 
-ValuePtr defineForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
+// Internal defines were given a slot when their scope was made.
+NodePtr define(Symbol name, NodePtr value, const ScopePtr& scope) {
+    if (scope == nullptr) {
+        return std::make_shared<GlobalDefineNode>(name, value);
+    }
+    if (auto slot = scope->find(name)) {
+        return std::make_shared<LocalDefineNode>(*slot, scope->isBoxed(*slot), value);
+    }
+    throw LispError("Cannot define " + name.name() + " here.");
+}
+
+NodePtr defineForm(const std::vector<ValuePtr>& args, const ScopePtr& scope) {
     if (args.empty()) {
         throw LispError("define requires two argument.");
     }
@@ -28,20 +40,17 @@ ValuePtr defineForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
     if (args[0]->isType(ValueType::PAIR)) {
 
         auto pair = static_cast<PairValue*>(args[0].get());
-        std::string name = pair->getCar()->toString();
+        auto name = Symbol::intern(pair->getCar()->toString());
         std::vector<ValuePtr> lambdaArgs{pair->getCdr()};
         lambdaArgs.insert(lambdaArgs.end(), args.begin() + 1, args.end());
-        ValuePtr lambda = lambdaForm(lambdaArgs, env);
-        env.define(name, lambda);
-        return std::make_shared<NilValue>();
-    
+        return define(name, lambdaForm(lambdaArgs, scope), scope);
+
     } else {
         if (args.size() < 2) {
             throw LispError("define requires exactly two arguments.");
         }
         if (auto name = args[0]->asSymbol()) {
-            env.define(*name, env.eval(args[1]));
-            return std::make_shared<NilValue>();
+            return define(*name, analyze(args[1], scope), scope);
         } else {
             throw LispError("Unimplemented.");
         }
@@ -49,188 +58,142 @@ ValuePtr defineForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
     }
 }
 
-ValuePtr quoteForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
+NodePtr quoteForm(const std::vector<ValuePtr>& args, const ScopePtr& scope) {
     if (args.size() != 1) {
         throw LispError("quote requires exactly one argument.");
     }
-    return args[0];
+    return std::make_shared<ConstantNode>(args[0]);
 }
 
-ValuePtr quasiquote(const ValuePtr& arg, EvalEnv& env) {
-    if (arg->isType(ValueType::PAIR)) {
-        if (auto symbol = arg->toVector()[0]->asSymbol()) {
-            if (symbol.value() == "unquote" || symbol.value() == ",") {
-                if (arg->toVector().size() != 2) {
-                    throw LispError("unquote requires exactly one argument.");
-                }
+NodePtr quasiquote(const ValuePtr& arg, const ScopePtr& scope) {
+    if (!arg->isType(ValueType::PAIR)) {
+        return std::make_shared<ConstantNode>(arg);
+    }
 
-                return env.eval(arg->toVector()[1]);
-            }
-        } else {
-            std::vector<ValuePtr> result;
-            for (const auto& element : arg->toVector()) {
-                result.push_back(quasiquote(element, env));
-            }
-            return std::make_shared<PairValue>(result);
+    auto pair = static_cast<PairValue*>(arg.get());
+    if (auto symbol = pair->getCar()->asSymbol(); symbol == symbols::UNQUOTE || symbol == symbols::UNQUOTE_COMMA) {
+        ListView operands(pair->getCdr());
+        if (operands.size() != 1 || !operands.isProper()) {
+            throw LispError("unquote requires exactly one argument.");
         }
-    } else {
-        return arg;
+        return analyze(*operands.begin(), scope);
     }
-    return nullptr;
+
+    auto car = quasiquote(pair->getCar(), scope);
+    auto cdr = quasiquote(pair->getCdr(), scope);
+    // A template without any unquote inside is just a quoted constant.
+    if (std::dynamic_pointer_cast<ConstantNode>(car) && std::dynamic_pointer_cast<ConstantNode>(cdr)) {
+        return std::make_shared<ConstantNode>(arg);
+    }
+    return std::make_shared<QuasiquoteNode>(car, cdr);
 }
 
-ValuePtr quasiquoteForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
+NodePtr quasiquoteForm(const std::vector<ValuePtr>& args, const ScopePtr& scope) {
     if (args.size() != 1) {
         throw LispError("quasiquote requires exactly one argument.");
     }
-    return quasiquote(args[0], env);
+    return quasiquote(args[0], scope);
 }
 
-ValuePtr ifForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
+NodePtr ifForm(const std::vector<ValuePtr>& args, const ScopePtr& scope) {
     if (args.size() != 2 && args.size() != 3) {
         throw LispError("if requires exactly two or three arguments.");
     }
 
-    ValuePtr pred = env.eval(args[0]);
-    if (pred->asBoolean() == false) {
-        if (args.size() == 3) {
-            return env.eval(args[2]);
-        } else {
-            return std::make_shared<NilValue>();
-        }
-    } else {
-        return env.eval(args[1]);
-    }
+    return std::make_shared<IfNode>(
+        analyze(args[0], scope),
+        analyze(args[1], scope),
+        args.size() == 3 ? analyze(args[2], scope) : nullptr
+    );
 }
 
-ValuePtr andForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
-    if (args.size() == 0) {
-        return std::make_shared<BooleanValue>(true);
-    }
-    if (args.size() < 2) {
+NodePtr andForm(const std::vector<ValuePtr>& args, const ScopePtr& scope) {
+    if (args.size() == 1) {
         throw LispError("and requires at least two arguments.");
     }
-
-    ValuePtr lastValue;
-    for (size_t i = 0; i < args.size(); i++) {
-        lastValue = env.eval(args[i]);
-        if (!lastValue->asBoolean()) {
-            return lastValue;
-        }
-    }
-
-    return lastValue;
+    return std::make_shared<AndNode>(analyzeList(args, scope));
 }
 
-ValuePtr orForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
-    if (args.size() == 0) {
-        return std::make_shared<BooleanValue>(false);
-    }
-    if (args.size() < 2) {
+NodePtr orForm(const std::vector<ValuePtr>& args, const ScopePtr& scope) {
+    if (args.size() == 1) {
         throw LispError("and requires at least two arguments.");
     }
-
-    ValuePtr lastValue;
-    for (size_t i = 0; i < args.size(); i++) {
-        lastValue = env.eval(args[i]);
-        if (lastValue->asBoolean()) {
-            return lastValue;
-        }
-    }
-
-    return lastValue;
+    return std::make_shared<OrNode>(analyzeList(args, scope));
 }
 
-ValuePtr lambdaForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
+NodePtr lambdaForm(const std::vector<ValuePtr>& args, const ScopePtr& scope) {
     if (args.size() < 2) {
         throw LispError("lambda requires at least two arguments.");
-    } 
+    }
 
-    std::vector<std::string> params;
-    std::ranges::transform(
-        args[0]->toVector(), 
-        std::back_inserter(params),
-        [](ValuePtr v) { return v->toString(); }
-    );
+    auto params = parameterNames(args[0]);
     std::vector<ValuePtr> body{args.begin() + 1, args.end()};
 
-    return std::make_shared<LambdaValue>(
-        params,
-        body, 
-        env.shared_from_this()
-    );
+    // The closure copies its free variables that are local here; the rest
+    // are globals.
+    std::vector<Scope::Capture> captured;
+    std::vector<LocalBinding> captures;
+    for (auto name : freeVariables(params, body)) {
+        if (auto binding = resolveLocal(name, scope)) {
+            captured.push_back({name, binding->boxed});
+            captures.push_back(*binding);
+        }
+    }
+    auto lambdaScope = makeScope(params, body, nullptr, std::move(captured));
+    auto code = std::make_shared<LambdaTemplate>(lambdaScope, analyzeList(body, lambdaScope), makeList(args));
+    return std::make_shared<LambdaNode>(std::move(code), std::move(captures));
 }
 
 
-ValuePtr condForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
+NodePtr condForm(const std::vector<ValuePtr>& args, const ScopePtr& scope) {
+    std::vector<CondNode::Clause> clauses;
     for (const auto& p : args) {
-        auto arg = static_cast<PairValue*>(p.get());
-        if (arg->toVector().empty()) {
+        if (!p->isType(ValueType::PAIR)) {
             throw LispError("empty clause in cond.");
         }
+        auto clause = static_cast<PairValue*>(p.get());
+        const auto& test = clause->getCar();
+        ListView body(clause->getCdr());
 
-        ValuePtr result;
-        if (arg->getCar()->asSymbol() == "else") {
+        if (test->asSymbol() == symbols::ELSE) {
             if (&p != &args.back()) {
                 throw LispError("else clause is not the last clause in cond.");
             }
-            for (size_t i = 1; i < arg->toVector().size(); i++) {
-                result = env.eval(arg->toVector()[i]);
-            }
-            if (result) {
-                return result;
-            } else {
+            if (body.empty()) {
                 throw LispError("there must be expressions after else.");
             }
-        }
-
-        ValuePtr condition = env.eval(arg->getCar());
-        if (condition->asBoolean()) {
-            for (size_t i = 1; i < arg->toVector().size(); i++) {
-                result = env.eval(arg->toVector()[i]);
-            }
-            return result ? result : condition;
+            clauses.push_back({nullptr, analyzeList(body, scope)});
+        } else {
+            clauses.push_back({analyze(test, scope), analyzeList(body, scope)});
         }
     }
 
-    throw LispError("No true clause in cond.");
+    return std::make_shared<CondNode>(clauses);
 }
 
-ValuePtr letForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
+NodePtr letForm(const std::vector<ValuePtr>& args, const ScopePtr& scope) {
     if (args.size() < 2) {
         throw LispError("Let form requires at least two arguments.");
     }
 
-    std::vector<std::string> identifiers;
-    std::vector<ValuePtr> initialValues;
-    for (const auto& binding : args[0]->toVector()) {
-        if (binding->toVector().size() != 2 || !binding->toVector()[0]->isType(ValueType::SYMBOL)) {
+    std::vector<Symbol> identifiers;
+    std::vector<NodePtr> initialValues;
+    for (const auto& binding : ListView(args[0])) {
+        ListView pair(binding);
+        if (pair.size() != 2 || !pair.isProper() || !(*pair.begin())->isType(ValueType::SYMBOL)) {
             throw LispError("Invalid binding in let form.");
         }
 
-        identifiers.push_back(binding->toVector()[0]->asSymbol().value());
-        initialValues.push_back(env.eval(binding->toVector()[1]));
+        identifiers.push_back((*pair.begin())->asSymbol().value());
+        initialValues.push_back(analyze(*std::ranges::next(pair.begin()), scope));
     }
 
-    auto childEnv = env.createChild(identifiers, initialValues);
-
-    ValuePtr result;
-    for (size_t i = 1; i < args.size(); i++) {
-        result = childEnv->eval(args[i]);
-    }
+    std::vector<ValuePtr> body{args.begin() + 1, args.end()};
+    auto letScope = makeScope(identifiers, body, scope);
 
-    return result;
+    return std::make_shared<LetNode>(letScope, initialValues, analyzeList(body, letScope));
 }
 
-ValuePtr beginForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
-    if (args.size() == 0) {
-        return std::make_shared<NilValue>();
-    }
-
-    ValuePtr result;
-    for (size_t i = 0; i < args.size(); i++) {
-        result = env.eval(args[i]);
-    }
-
-    return result;
+NodePtr beginForm(const std::vector<ValuePtr>& args, const ScopePtr& scope) {
+    return std::make_shared<BeginNode>(analyzeList(args, scope));
 }
@@ -1,26 +1,28 @@
 #ifndef FORMS_H
 #define FORMS_H
 
+#include <unordered_map>
 #include <vector>
 
-#include "./eval_env.h"
+#include "./node.h"
+#include "./scope.h"
 #include "./value.h"
 
-using SpecialFormType = ValuePtr(const std::vector<ValuePtr>&, EvalEnv&);
+using SpecialFormType = NodePtr(const std::vector<ValuePtr>&, const ScopePtr&);
 
-ValuePtr defineForm(const std::vector<ValuePtr>& args, EvalEnv& env);
-ValuePtr quoteForm(const std::vector<ValuePtr>& args, EvalEnv& env);
-ValuePtr quasiquoteForm(const std::vector<ValuePtr>& args, EvalEnv& env);
+NodePtr defineForm(const std::vector<ValuePtr>& args, const ScopePtr& scope);
+NodePtr quoteForm(const std::vector<ValuePtr>& args, const ScopePtr& scope);
+NodePtr quasiquoteForm(const std::vector<ValuePtr>& args, const ScopePtr& scope);
 
-ValuePtr ifForm(const std::vector<ValuePtr>& args, EvalEnv& env);
-ValuePtr andForm(const std::vector<ValuePtr>& args, EvalEnv& env);
-ValuePtr orForm(const std::vector<ValuePtr>& args, EvalEnv& env);
-ValuePtr lambdaForm(const std::vector<ValuePtr>& args, EvalEnv& env);
-ValuePtr condForm(const std::vector<ValuePtr>& args, EvalEnv& env);
-ValuePtr letForm(const std::vector<ValuePtr>& args, EvalEnv& env);
-ValuePtr beginForm(const std::vector<ValuePtr>& args, EvalEnv& env);
+NodePtr ifForm(const std::vector<ValuePtr>& args, const ScopePtr& scope);
+NodePtr andForm(const std::vector<ValuePtr>& args, const ScopePtr& scope);
+NodePtr orForm(const std::vector<ValuePtr>& args, const ScopePtr& scope);
+NodePtr lambdaForm(const std::vector<ValuePtr>& args, const ScopePtr& scope);
+NodePtr condForm(const std::vector<ValuePtr>& args, const ScopePtr& scope);
+NodePtr letForm(const std::vector<ValuePtr>& args, const ScopePtr& scope);
+NodePtr beginForm(const std::vector<ValuePtr>& args, const ScopePtr& scope);
 
 
-extern std::unordered_map<std::string, SpecialFormType*> SPECIAL_FORMS;
+extern std::unordered_map<Symbol, SpecialFormType*> SPECIAL_FORMS;
 
 #endif
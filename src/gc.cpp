@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <limits>
+
+#include "./gc.h"
+#include "./value.h"
+
+namespace {
+
+// Never destroyed: values owned by static objects are released during
+// static destruction, possibly after this function's statics.
+std::vector<Collectable*>& registry() {
+    static auto objects = new std::vector<Collectable*>;
+    return *objects;
+}
+
+}
+
+
+/**Collectable class
+ * Every collectable is listed in the registry while it lives. The
+ * collector scans the registry in order, and as it is an array rather
+ * than a chain through the objects, the scan does not wait for one object
+ * to be loaded to find the next.
+ */
+Collectable::Collectable() : index{registry().size()} {
+    registry().push_back(this);
+    Collector::count++;
+    Collector::allocated++;
+    Collector::created++;
+}
+
+Collectable::~Collectable() {
+    auto& objects = registry();
+    objects[index] = objects.back();
+    objects[index]->index = index;
+    objects.pop_back();
+    Collector::count--;
+}
+
+
+/**Collector class
+ * Methods of the cycle collector
+ */
+constexpr ptrdiff_t REACHABLE = std::numeric_limits<ptrdiff_t>::max();
+
+// Between collections every gcRefs is zero, so one pass can both add an
+// object's count and subtract the references it holds to others.
+size_t Collector::collect() {
+    allocated = 0;
+    const auto& objects = registry();
+    std::vector<Collectable*> children;
+
+    for (auto object : objects) {
+        object->gcRefs += static_cast<ptrdiff_t>(object->refCount());
+        children.clear();
+        object->trace(children);
+        for (auto child : children) {
+            child->gcRefs--;
+        }
+    }
+
+    // An object with references left over is held from outside. A count of
+    // zero means it is still being constructed and not owned by anyone yet.
+    std::vector<Collectable*> pending;
+    for (auto object : objects) {
+        if (object->gcRefs == REACHABLE || (object->gcRefs <= 0 && object->refCount() != 0)) {
+            continue;
+        }
+        object->gcRefs = REACHABLE;
+        pending.push_back(object);
+        while (!pending.empty()) {
+            auto current = pending.back();
+            pending.pop_back();
+            children.clear();
+            current->trace(children);
+            for (auto child : children) {
+                if (child->gcRefs != REACHABLE) {
+                    child->gcRefs = REACHABLE;
+                    pending.push_back(child);
+                }
+            }
+        }
+    }
+
+    // Hold the garbage while its references are dropped, so nothing is
+    // freed halfway through; releasing these handles frees all of it.
+    std::vector<ValuePtr> values;
+    for (auto object : objects) {
+        if (object->gcRefs != REACHABLE) {
+            values.emplace_back(static_cast<Value*>(object));
+        }
+        object->gcRefs = 0;
+    }
+    for (const auto& value : values) {
+        value.get()->clearReferences();
+    }
+    size_t garbage = values.size();
+    values.clear();
+
+    threshold = std::max(MIN_THRESHOLD, count);
+    return garbage;
+}
@@ -0,0 +1,87 @@
+#ifndef GC_H
+#define GC_H
+
+#include <cstddef>
+#include <vector>
+
+/**Collectable class
+ * Base of every object that can take part in a reference cycle, which
+ * is every heap value. Each one reports how many references it has,
+ * which collectables it references itself and how to drop those
+ * references, which is all the cycle collector needs.
+ */
+class Collectable {
+    size_t index;
+    ptrdiff_t gcRefs = 0;
+
+    friend class Collector;
+
+public:
+    Collectable();
+    Collectable(const Collectable&) = delete;
+    virtual ~Collectable();
+
+    virtual size_t refCount() const = 0;
+    virtual void trace(std::vector<Collectable*>& children) const {}
+    virtual void clearReferences() {}
+};
+
+
+/**Collector class
+ * Reference counting frees most garbage the moment it is dropped, but not
+ * a procedure that captures a box holding itself. Every so many
+ * allocations the collector subtracts the references collectables hold to
+ * each other from their counts. Whatever still has references left is held
+ * from outside (native stack, interpreter state) and, with everything it
+ * reaches, survives. The rest only keeps itself alive: its references are
+ * dropped, and reference counting then frees it.
+ */
+class Collector {
+    static constexpr size_t MIN_THRESHOLD = 100000;
+
+    static inline size_t count = 0;
+    static inline size_t allocated = 0;
+    static inline size_t threshold = MIN_THRESHOLD;
+    static inline size_t created = 0;
+    static inline size_t paused = 0;
+
+    friend class Collectable;
+
+public:
+    // Holds collection off while it lives, for code that creates many
+    // objects none of which can be garbage yet. Afterwards the collector
+    // counts allocations as if it had just run.
+    class Pause {
+    public:
+        Pause() {
+            paused++;
+        }
+        Pause(const Pause&) = delete;
+        ~Pause() {
+            if (--paused == 0 && allocated >= threshold) {
+                allocated = 0;
+                threshold = count;
+            }
+        }
+    };
+
+    static void maybeCollect() {
+        if (allocated >= threshold && paused == 0) {
+            collect();
+        }
+    }
+
+    // Returns the number of objects found to be garbage.
+    static size_t collect();
+
+    static size_t liveObjects() {
+        return count;
+    }
+
+    // Collectables created since startup, never reset.
+    static size_t totalAllocations() {
+        return created;
+    }
+};
+
+#endif
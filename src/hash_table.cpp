@@ -0,0 +1,144 @@
+#include "./hash_table.h"
+
+#include <bit>
+
+#include "./number.h"
+
+/**HashTableValue class
+ * Methods of the open-addressing table
+ */
+size_t HashTableValue::hash(const ValuePtr& key) const {
+    if (kind == Kind::EQUAL) {
+        return hashValue(key);
+    }
+    if (key->isType(ValueType::NUMERIC)) {
+        return numbers::hash(key);
+    }
+    if (key.get() == nullptr) {
+        return static_cast<size_t>(key->getType()) * 2 + key->asBoolean();
+    }
+    return std::hash<const void*>{}(key.get());
+}
+
+bool HashTableValue::same(const ValuePtr& left, const ValuePtr& right) const {
+    if (kind == Kind::EQUAL) {
+        return equalValues(left, right);
+    }
+    if (left->getType() != right->getType()) {
+        return false;
+    }
+    // Numbers are compared by value, bignums included, as by eq?.
+    if (left->isType(ValueType::NUMERIC)) {
+        return numbers::eqv(left, right);
+    }
+    if (left.get() == nullptr) {
+        return left->asBoolean() == right->asBoolean();
+    }
+    return left.get() == right.get();
+}
+
+// Hashes of numbers and pointers often differ only in their high bits;
+// the multiplication spreads them over the bits the mask keeps.
+static size_t firstSlot(size_t hash, size_t capacity) {
+    return (hash * 0x9e3779b97f4a7c15) >> (64 - std::countr_zero(capacity)) & (capacity - 1);
+}
+
+size_t HashTableValue::find(const ValuePtr& key, size_t hash) const {
+    size_t mask = entries.size() - 1;
+    for (size_t i = firstSlot(hash, entries.size());; i = (i + 1) & mask) {
+        const auto& entry = entries[i];
+        if (!entry.key) {
+            if (!entry.removed) {
+                return entries.size();
+            }
+        } else if (entry.hash == hash && same(entry.key, key)) {
+            return i;
+        }
+    }
+}
+
+void HashTableValue::rebuild(size_t capacity) {
+    auto old = std::exchange(entries, std::vector<Entry>(capacity));
+    size_t mask = capacity - 1;
+    for (auto& entry : old) {
+        if (entry.key) {
+            size_t i = firstSlot(entry.hash, capacity);
+            while (entries[i].key) {
+                i = (i + 1) & mask;
+            }
+            entries[i] = std::move(entry);
+        }
+    }
+    used = count;
+}
+
+const ValuePtr* HashTableValue::lookup(const ValuePtr& key) const {
+    size_t i = find(key, hash(key));
+    return i == entries.size() ? nullptr : &entries[i].value;
+}
+
+void HashTableValue::set(ValuePtr key, ValuePtr value) {
+    size_t keyHash = hash(key);
+    if (size_t i = find(key, keyHash); i != entries.size()) {
+        entries[i].value = std::move(value);
+        return;
+    }
+    // At most three quarters of the entries are in use, so probe
+    // sequences stay short and always end at a free entry.
+    if ((used + 1) * 4 > entries.size() * 3) {
+        size_t capacity = entries.size();
+        while ((count + 1) * 2 > capacity) {
+            capacity *= 2;
+        }
+        rebuild(capacity);
+    }
+    size_t mask = entries.size() - 1;
+    size_t i = firstSlot(keyHash, entries.size());
+    while (entries[i].key) {
+        i = (i + 1) & mask;
+    }
+    auto& entry = entries[i];
+    if (!entry.removed) {
+        used++;
+    }
+    entry = {std::move(key), std::move(value), keyHash, false};
+    count++;
+}
+
+bool HashTableValue::remove(const ValuePtr& key) {
+    size_t i = find(key, hash(key));
+    if (i == entries.size()) {
+        return false;
+    }
+    entries[i] = {nullptr, nullptr, 0, true};
+    count--;
+    return true;
+}
+
+std::vector<std::pair<ValuePtr, ValuePtr>> HashTableValue::items() const {
+    std::vector<std::pair<ValuePtr, ValuePtr>> result;
+    result.reserve(count);
+    for (const auto& entry : entries) {
+        if (entry.key) {
+            result.emplace_back(entry.key, entry.value);
+        }
+    }
+    return result;
+}
+
+std::string HashTableValue::toString() const {
+    return "#<hash-table>";
+}
+
+void HashTableValue::trace(std::vector<Collectable*>& children) const {
+    for (const auto& entry : entries) {
+        traceValue(entry.key, children);
+        traceValue(entry.value, children);
+    }
+}
+
+void HashTableValue::clearReferences() {
+    entries.assign(MIN_CAPACITY, {});
+    count = 0;
+    used = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef HASH_TABLE_H
+#define HASH_TABLE_H
+
+#include <utility>
+#include <vector>
+
+#include "./value.h"
+
+/**HashTableValue class
+ * A mutable map from keys to values, stored with open addressing and
+ * linear probing in an array whose size is a power of two. Each entry
+ * keeps the full hash of its key, so probing compares keys only when the
+ * hashes match and growing never hashes a key twice. A removed entry
+ * leaves a marker that keeps later entries of its probe sequence
+ * reachable; markers are dropped whenever the array is rebuilt.
+ *
+ * An equal? table compares keys with equalValues, an eq? table the way
+ * eq? does: numbers by value, everything else by identity. A key must
+ * not be changed while it is in an equal? table.
+ */
+class HashTableValue : public Value {
+public:
+    enum class Kind {
+        EQUAL,
+        EQ
+    };
+
+private:
+    struct Entry {
+        ValuePtr key;       // empty for a free or removed entry
+        ValuePtr value;
+        size_t hash = 0;
+        bool removed = false;
+    };
+
+    static constexpr size_t MIN_CAPACITY = 8;
+
+    Kind kind;
+    std::vector<Entry> entries;
+    size_t count = 0;
+    size_t used = 0;    // entries holding a key or a removed marker
+
+    size_t hash(const ValuePtr& key) const;
+    bool same(const ValuePtr& left, const ValuePtr& right) const;
+    // The entry holding key, or entries.size() if there is none.
+    size_t find(const ValuePtr& key, size_t hash) const;
+    void rebuild(size_t capacity);
+
+public:
+    HashTableValue(Kind kind) : Value(ValueType::HASH_TABLE), kind{kind}, entries(MIN_CAPACITY) {}
+
+    Kind getKind() const {
+        return kind;
+    }
+    size_t size() const {
+        return count;
+    }
+
+    // The value stored under key, or nullptr.
+    const ValuePtr* lookup(const ValuePtr& key) const;
+    void set(ValuePtr key, ValuePtr value);
+    bool remove(const ValuePtr& key);
+
+    // The keys and values, in no particular order.
+    std::vector<std::pair<ValuePtr, ValuePtr>> items() const;
+
+    std::string toString() const override;
+
+    void trace(std::vector<Collectable*>& children) const override;
+    void clearReferences() override;
+};
+
+#endif
@@ -0,0 +1,497 @@
+#include "./image.h"
+
+#include <cstring>
+#include <fstream>
+#include <tuple>
+#include <unordered_map>
+
+#include "./binary_io.h"
+#include "./builtins.h"
+#include "./error.h"
+#include "./gc.h"
+#include "./hash_table.h"
+#include "./mapped_file.h"
+#include "./node.h"
+#include "./number.h"
+#include "./vm.h"
+
+namespace {
+
+constexpr char MAGIC[] = {'M', 'L', 'I', 'M', 'A', 'G', 'E', 4};   // last byte is the format version
+
+enum class Tag : uint8_t {
+    // References to values, inside records
+    NIL,
+    FALSE,
+    TRUE,
+    NUMBER,         // flonum
+    INTEGER,        // fixnum
+    OBJECT,         // object number
+    UNBOUND,        // capture of a define that has not run
+
+    // Records, each creating the next object unless noted
+    STRING,         // bytes
+    SYMBOL,         // name
+    BIGNUM,         // decimal digits
+    PAIR,           // car, cdr
+    BUILTIN,        // name
+    VECTOR,         // element count
+    HASH_TABLE,     // 1 for an eq? table, 0 for an equal? one
+    LAMBDA,         // source, capture count, capture names
+    CLOSURE,        // source, capture count, capture names
+    CAPTURES,       // lambda or closure, value count, values; creates nothing
+    ELEMENTS,       // vector, values; creates nothing
+    ENTRIES,        // hash table, entry count, keys and values; creates nothing
+    DEFINE,         // name, value; creates nothing
+    END,
+};
+
+
+class Writer : public BinaryWriter {
+    const EvalEnv& global;
+    std::unordered_map<const void*, uint64_t> ids;
+    uint64_t next = 0;
+    std::unordered_map<const Value*, std::string> builtinNames;
+    std::vector<std::pair<const Value*, Arguments>> pendingCaptures;
+    std::vector<const VectorValue*> pendingVectors;
+    std::vector<const HashTableValue*> pendingTables;
+
+    void tag(Tag value) {
+        byte(static_cast<uint8_t>(value));
+    }
+
+    uint64_t created(const void* object) {
+        ids.emplace(object, next);
+        return next++;
+    }
+
+    // Writes a value that does not need a record, or the number of one
+    // that has been written already.
+    void reference(const ValuePtr& value) {
+        if (!value) {
+            tag(Tag::UNBOUND);
+        } else if (value->isFlonum()) {
+            tag(Tag::NUMBER);
+            real(value->asNumber().value());
+        } else if (value->isFixnum()) {
+            tag(Tag::INTEGER);
+            integer(value->getFixnum());
+        } else if (value->isType(ValueType::NIL)) {
+            tag(Tag::NIL);
+        } else if (value->isType(ValueType::BOOLEAN)) {
+            tag(value->asBoolean() ? Tag::TRUE : Tag::FALSE);
+        } else {
+            tag(Tag::OBJECT);
+            count(ids.at(value.get()));
+        }
+    }
+
+    uint64_t symbol(Symbol name) {
+        return object(name.toValue());
+    }
+
+    // Writes the records of a value and of everything it needs first.
+    // Lists are walked with an explicit stack, however long they are.
+    uint64_t object(const ValuePtr& root) {
+        std::vector<ValuePtr> stack{root};
+        while (!stack.empty()) {
+            ValuePtr current = stack.back();
+            if (current.get() == nullptr || ids.contains(current.get())) {
+                stack.pop_back();
+                continue;
+            }
+            if (!current->isType(ValueType::PAIR)) {
+                leaf(current);
+                stack.pop_back();
+                continue;
+            }
+            auto pair = static_cast<PairValue*>(current.get());
+            bool ready = true;
+            for (const auto& child : {pair->getCar(), pair->getCdr()}) {
+                if (child.get() != nullptr && !ids.contains(child.get())) {
+                    stack.push_back(child);
+                    ready = false;
+                }
+            }
+            if (ready) {
+                tag(Tag::PAIR);
+                reference(pair->getCar());
+                reference(pair->getCdr());
+                created(current.get());
+                stack.pop_back();
+            }
+        }
+        return root.get() != nullptr ? ids.at(root.get()) : 0;
+    }
+
+    void leaf(const ValuePtr& value) {
+        if (value->isType(ValueType::STRING)) {
+            tag(Tag::STRING);
+            bytes(value->asString().value());
+        } else if (auto name = value->asSymbol()) {
+            tag(Tag::SYMBOL);
+            bytes(name->name());
+        } else if (value->isType(ValueType::NUMERIC)) {
+            tag(Tag::BIGNUM);
+            bytes(value->toString());
+        } else if (value->isType(ValueType::BUILTIN)) {
+            auto found = builtinNames.find(value.get());
+            if (found == builtinNames.end()) {
+                throw LispError("Cannot save " + value->toString() + " in an image.");
+            }
+            tag(Tag::BUILTIN);
+            bytes(found->second);
+        } else if (value->isType(ValueType::VECTOR)) {
+            auto vector = static_cast<const VectorValue*>(value.get());
+            tag(Tag::VECTOR);
+            count(vector->getElements().size());
+            pendingVectors.push_back(vector);
+        } else if (value->isType(ValueType::HASH_TABLE)) {
+            auto table = static_cast<const HashTableValue*>(value.get());
+            tag(Tag::HASH_TABLE);
+            byte(table->getKind() == HashTableValue::Kind::EQ);
+            pendingTables.push_back(table);
+        } else if (auto lambda = dynamic_cast<const LambdaValue*>(value.get())) {
+            const auto& code = *lambda->getTemplate();
+            procedure(Tag::LAMBDA, code.getSource(), code.captureNames());
+            pendingCaptures.emplace_back(lambda, lambda->getCaptures());
+        } else if (auto closure = dynamic_cast<const ClosureValue*>(value.get())) {
+            const auto& proto = *closure->getPrototype();
+            if (!proto.source) {
+                throw LispError("Cannot save " + value->toString() + " in an image.");
+            }
+            std::vector<Symbol> names;
+            for (const auto& capture : proto.captures) {
+                names.push_back(capture.name);
+            }
+            procedure(Tag::CLOSURE, proto.source, names);
+            pendingCaptures.emplace_back(closure, closure->getCaptures());
+        } else {
+            throw LispError("Cannot save " + value->toString() + " in an image.");
+        }
+        created(value.get());
+    }
+
+    // A procedure is saved as its source and the names of its captures; the
+    // values captured follow in a CAPTURES record.
+    void procedure(Tag kind, const ValuePtr& source, const std::vector<Symbol>& captures) {
+        uint64_t sourceId = object(source);
+        std::vector<uint64_t> names;
+        for (auto name : captures) {
+            names.push_back(symbol(name));
+        }
+        tag(kind);
+        count(sourceId);
+        count(names.size());
+        for (auto name : names) {
+            count(name);
+        }
+    }
+
+    void fillPending() {
+        while (!pendingCaptures.empty() || !pendingVectors.empty() || !pendingTables.empty()) {
+            if (!pendingTables.empty()) {
+                auto table = pendingTables.back();
+                pendingTables.pop_back();
+                auto items = table->items();
+                for (const auto& [key, value] : items) {
+                    object(key);
+                    object(value);
+                }
+                tag(Tag::ENTRIES);
+                count(ids.at(table));
+                count(items.size());
+                for (const auto& [key, value] : items) {
+                    reference(key);
+                    reference(value);
+                }
+            } else if (!pendingVectors.empty()) {
+                auto vector = pendingVectors.back();
+                pendingVectors.pop_back();
+                for (const auto& value : vector->getElements()) {
+                    object(value);
+                }
+                tag(Tag::ELEMENTS);
+                count(ids.at(vector));
+                for (const auto& value : vector->getElements()) {
+                    reference(value);
+                }
+            } else {
+                auto [owner, values] = pendingCaptures.back();
+                pendingCaptures.pop_back();
+                // Boxes only matter while the define that fills them has
+                // not run; after that the value is all a capture needs.
+                std::vector<ValuePtr> captures;
+                for (const auto& capture : values) {
+                    if (auto box = dynamic_cast<const BoxValue*>(capture.get())) {
+                        if (!box->value) {
+                            throw LispError("Cannot save a procedure whose variables are not all defined.");
+                        }
+                        captures.push_back(box->value);
+                    } else {
+                        captures.push_back(capture);
+                    }
+                }
+                for (const auto& value : captures) {
+                    object(value);
+                }
+                tag(Tag::CAPTURES);
+                count(ids.at(owner));
+                count(captures.size());
+                for (const auto& value : captures) {
+                    reference(value);
+                }
+            }
+        }
+    }
+
+public:
+    Writer(std::ofstream& out, const EvalEnv& global) : BinaryWriter(out), global{global} {
+        for (const auto& [name, value] : builtins::frame()) {
+            builtinNames.emplace(value.get(), name.name());
+        }
+    }
+
+    void write() {
+        const auto& bindings = global.globals();
+        for (const auto& [name, value] : bindings) {
+            symbol(name);
+            object(value);
+        }
+        fillPending();
+        for (const auto& [name, value] : bindings) {
+            tag(Tag::DEFINE);
+            count(ids.at(name.toValue().get()));
+            reference(value);
+        }
+        tag(Tag::END);
+    }
+};
+
+
+class Loader {
+    MappedFile file;
+    BinaryReader input;
+    std::shared_ptr<EvalEnv> global;
+    std::vector<ValuePtr> objects;
+    std::unordered_map<uint64_t, std::shared_ptr<const LambdaTemplate>> templates;
+    std::unordered_map<uint64_t, PrototypePtr> prototypes;
+    // Table entries, inserted at the end, once the vectors and pairs in
+    // their keys are complete and hash as they will be looked up.
+    std::vector<std::tuple<ValuePtr, ValuePtr, ValuePtr>> entries;
+
+    Tag tag() {
+        return static_cast<Tag>(input.byte());
+    }
+
+    ValuePtr value(uint64_t id) {
+        if (id >= objects.size()) {
+            throw std::runtime_error("Corrupt image file");
+        }
+        return objects[id];
+    }
+
+    Symbol symbol(uint64_t id) {
+        if (auto name = value(id)->asSymbol()) {
+            return *name;
+        }
+        throw std::runtime_error("Corrupt image file");
+    }
+
+    ValuePtr reference() {
+        switch (tag()) {
+        case Tag::NIL:
+            return ValuePtr::nil();
+        case Tag::FALSE:
+            return ValuePtr::boolean(false);
+        case Tag::TRUE:
+            return ValuePtr::boolean(true);
+        case Tag::NUMBER:
+            return ValuePtr::number(input.real());
+        case Tag::INTEGER:
+            return ValuePtr::integer(input.integer());
+        case Tag::OBJECT:
+            return value(input.count());
+        case Tag::UNBOUND:
+            return nullptr;
+        default:
+            throw std::runtime_error("Corrupt image file");
+        }
+    }
+
+    std::vector<Symbol> symbols(size_t count) {
+        std::vector<Symbol> result;
+        for (size_t i = 0; i < count; i++) {
+            result.push_back(symbol(input.count()));
+        }
+        return result;
+    }
+
+    ValuePtr source(uint64_t id) {
+        auto result = value(id);
+        if (!result->isType(ValueType::PAIR)) {
+            throw std::runtime_error("Corrupt image file");
+        }
+        return result;
+    }
+
+    // Procedures with the same source share their template or prototype,
+    // which is only analyzed or compiled when one of them is first called.
+    ValuePtr lambda(uint64_t sourceId, std::vector<Symbol> names) {
+        auto& code = templates[sourceId];
+        if (!code) {
+            code = std::make_shared<LambdaTemplate>(source(sourceId), std::move(names));
+        }
+        return makeValue<LambdaValue>(code, ValueVector{});
+    }
+
+    ValuePtr closure(uint64_t sourceId, const std::vector<Symbol>& names) {
+        auto& proto = prototypes[sourceId];
+        if (!proto) {
+            auto restored = std::make_shared<Prototype>();
+            restored->source = source(sourceId);
+            for (size_t i = 0; i < names.size(); i++) {
+                restored->captures.push_back({false, static_cast<uint16_t>(i), names[i]});
+            }
+            proto = std::move(restored);
+        }
+        return makeValue<ClosureValue>(proto, std::vector<ValuePtr>{});
+    }
+
+public:
+    Loader(const std::string& path, std::shared_ptr<EvalEnv> global) :
+        file{path}, input{file.view()}, global{std::move(global)} {}
+
+    void load() {
+        auto header = input.bytes(sizeof(MAGIC));
+        if (std::memcmp(header.data(), MAGIC, sizeof(MAGIC)) != 0) {
+            throw std::runtime_error("Not an image file");
+        }
+        // Everything loaded is held by the object table until the end.
+        Collector::Pause pause;
+        while (true) {
+            switch (tag()) {
+            case Tag::STRING:
+                objects.push_back(makeValue<StringValue>(std::string(input.bytes())));
+                break;
+            case Tag::SYMBOL:
+                objects.push_back(SymbolValue::intern(input.bytes()));
+                break;
+            case Tag::BIGNUM:
+                objects.push_back(numbers::fromLiteral(input.bytes(), 0));
+                break;
+            case Tag::PAIR:
+            {
+                auto car = reference();
+                auto cdr = reference();
+                objects.push_back(makeValue<PairValue>(std::move(car), std::move(cdr)));
+                break;
+            }
+            case Tag::BUILTIN:
+            {
+                auto name = Symbol::intern(input.bytes());
+                auto found = builtins::frame().find(name);
+                if (found == builtins::frame().end()) {
+                    throw std::runtime_error("Unknown builtin " + name.name() + " in image");
+                }
+                objects.push_back(found->second);
+                break;
+            }
+            case Tag::VECTOR:
+                objects.push_back(makeValue<VectorValue>(std::vector<ValuePtr>(input.count(), ValuePtr::nil())));
+                break;
+            case Tag::HASH_TABLE:
+                objects.push_back(makeValue<HashTableValue>(input.byte() ? HashTableValue::Kind::EQ
+                                                                         : HashTableValue::Kind::EQUAL));
+                break;
+            case Tag::LAMBDA:
+            {
+                uint64_t source = input.count();
+                auto names = symbols(input.count());
+                objects.push_back(lambda(source, std::move(names)));
+                break;
+            }
+            case Tag::CLOSURE:
+            {
+                uint64_t source = input.count();
+                auto names = symbols(input.count());
+                objects.push_back(closure(source, names));
+                break;
+            }
+            case Tag::CAPTURES:
+            {
+                auto procedure = value(input.count());
+                std::vector<ValuePtr> captures(input.count());
+                for (auto& capture : captures) {
+                    capture = reference();
+                }
+                if (auto lambda = dynamic_cast<LambdaValue*>(procedure.get());
+                    lambda && lambda->getTemplate()->captureNames().size() == captures.size()) {
+                    lambda->setCaptures(ValueVector(captures.begin(), captures.end()));
+                } else if (auto compiled = dynamic_cast<ClosureValue*>(procedure.get());
+                           compiled && compiled->getPrototype()->captures.size() == captures.size()) {
+                    compiled->setCaptures(std::move(captures));
+                } else {
+                    throw std::runtime_error("Corrupt image file");
+                }
+                break;
+            }
+            case Tag::ELEMENTS:
+            {
+                auto vector = value(input.count());
+                if (!vector->isType(ValueType::VECTOR)) {
+                    throw std::runtime_error("Corrupt image file");
+                }
+                for (auto& element : static_cast<VectorValue*>(vector.get())->getElements()) {
+                    element = reference();
+                }
+                break;
+            }
+            case Tag::ENTRIES:
+            {
+                auto table = value(input.count());
+                if (!table->isType(ValueType::HASH_TABLE)) {
+                    throw std::runtime_error("Corrupt image file");
+                }
+                for (size_t n = input.count(); n > 0; n--) {
+                    auto key = reference();
+                    auto entry = reference();
+                    entries.emplace_back(table, std::move(key), std::move(entry));
+                }
+                break;
+            }
+            case Tag::DEFINE:
+            {
+                auto name = symbol(input.count());
+                global->define(name, reference());
+                break;
+            }
+            case Tag::END:
+                for (auto& [table, key, entry] : entries) {
+                    static_cast<HashTableValue*>(table.get())->set(std::move(key), std::move(entry));
+                }
+                return;
+            default:
+                throw std::runtime_error("Corrupt image file");
+            }
+        }
+    }
+};
+
+}
+
+void image::save(const std::string& path, EvalEnv& env) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        throw LispError("Cannot write image file " + path);
+    }
+    out.write(MAGIC, sizeof(MAGIC));
+    Writer(out, env.globalFrame()).write();
+    if (!out.flush()) {
+        throw LispError("Cannot write image file " + path);
+    }
+}
+
+void image::load(const std::string& path, const std::shared_ptr<EvalEnv>& env) {
+    Loader(path, env).load();
+}
@@ -0,0 +1,34 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <memory>
+#include <string>
+
+#include "./eval_env.h"
+
+/**Heap images
+ * The bindings of a global frame and everything they reach, written to a
+ * file so that a later process can start from them instead of running the
+ * definitions again. Objects are numbered in the order they are written
+ * and refer to each other by number, so an image can be loaded at any
+ * address. Every object is written after the ones it refers to, except
+ * for the captures of procedures and the contents of vectors and hash
+ * tables, which are filled in at the end because they can lead back to
+ * the object that holds them. Procedures are stored as their source and
+ * the names and values of their captures. Loading restores them without
+ * looking at their code, which is analyzed or compiled when they are
+ * first called, so procedures a program never calls cost no more than
+ * their source.
+ */
+namespace image {
+
+// Throws LispError if a binding cannot be saved or the file not written.
+void save(const std::string& path, EvalEnv& env);
+
+// Defines the bindings saved at path in the global frame env. Throws
+// std::runtime_error if the file cannot be read.
+void load(const std::string& path, const std::shared_ptr<EvalEnv>& env);
+
+}
+
+#endif
@@ -1,60 +1,58 @@
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <string>
 
+#include "./error.h"
 #include "./eval_env.h"
-#include "./parser.h"
-#include "./tokenizer.h"
+#include "./fasl.h"
+#include "./image.h"
+#include "./mapped_file.h"
+#include "./reader.h"
 #include "./value.h"
+#include "./vm.h"
 
 #include "rjsj_test.hpp"
 
-void process(std::istream& input, bool print_result, std::vector<std::string> args = {"0", ""}) {
+enum class Engine {
+    TREE,   // tree-walking evaluator over analyzed forms
+    VM      // bytecode compiler and virtual machine
+};
+
+// Source is a Reader, or a fasl::Loader or fasl::Recorder of a script. The global
+// frame starts from the definitions saved in image, unless it is empty.
+template <typename Source>
+void process(Source& reader, bool print_result, Engine engine, const std::string& image,
+             std::vector<std::string> args = {"0", ""}) {
     std::shared_ptr<EvalEnv> env = std::make_shared<EvalEnv>();
+    if (!image.empty()) {
+        try {
+            image::load(image, env);
+        } catch (std::runtime_error& e) {
+            std::cerr << image << ": " << e.what() << std::endl;
+            std::exit(1);
+        }
+    }
+    VM vm(*env);
+    auto evaluate = [&](ValuePtr value) {
+        return engine == Engine::VM ? vm.eval(std::move(value)) : env->eval(std::move(value));
+    };
     args[0] = "(define argc " + args[0] + ")";
     args[1] = "(define argv (list" + args[1] + "))";
-    for (auto line : args){ // Define argc and argv
-        auto tokens = Tokenizer::tokenize(line);
-        Parser parser(std::move(tokens));
-        auto value = parser.parse();
-        env->eval(std::move(value));
+    for (const auto& line : args){ // Define argc and argv
+        evaluate(Reader(line).read().value());
     }
     while (true) {
         try {
-            if (print_result) {
-                std::cout << "\033[31m" << ">>> " << "\033[0m";
-            }
-            std::string line;
-            std::getline(input, line);
-            // More than one line
-            // While the number of opening parentheses is greater than the number of closing parentheses
-            while (std::count(line.begin(), line.end(), '(') > std::count(line.begin(), line.end(), ')')) {
-                int n = std::count(line.begin(), line.end(), '(') - std::count(line.begin(), line.end(), ')');
-                if (print_result) {
-                    std::cout << "...";
-                    for (int i = 0; i < n; i++) {
-                        std::cout << "    ";
-                    }
-                }
-                std::string extraLine;
-                std::getline(input, extraLine);
-                line += "\n" + extraLine;
-            }
-            if (!input.eof() || !line.empty()) {
-                if (line.empty() || line[0] == ';') {
-                    continue;
-                }
-                auto tokens = Tokenizer::tokenize(line);
-                Parser parser(std::move(tokens));
-                auto value = parser.parse();
-                auto result = env->eval(std::move(value));
-                if (print_result) {
-                    std::cout << result->toString() << std::endl;
-                } 
-            } else {
+            auto value = reader.read();
+            if (!value) {
                 std::exit(0);
             }
-            
+            auto result = evaluate(std::move(*value));
+            if (print_result) {
+                std::cout << result->toString() << std::endl;
+            }
         } catch (std::runtime_error& e) {
             std::cerr << "Error: " << e.what() << std::endl;
         }
@@ -72,50 +70,222 @@ std::string parseArgs(std::vector<std::string> args) {
     return result;
 }
 
-struct TestCtx {
+template <Engine engine>
+ValuePtr evaluate(EvalEnv& env, ValuePtr form) {
+    if constexpr (engine == Engine::VM) {
+        return VM(env).eval(std::move(form));
+    } else {
+        return env.eval(std::move(form));
+    }
+}
+
+/**Test procedures
+ * Defined by the test contexts for the suites that go through files:
+ *   (scratch name)             path of name in a directory of the test run
+ *   (write-script path forms)  writes a script of the forms to path,
+ *                              with strings written as they are
+ *   (run-cached path)          runs the script at path in a fresh
+ *                              environment, with a cache in the scratch
+ *                              directory, and returns whether the cache
+ *                              was used and the value of the last form,
+ *                              as a pair
+ *   (in-image path form)       the value of form in a fresh environment
+ *                              started from the image at path
+ * Procedures that run code use the engine of their context.
+ */
+namespace testing {
+
+std::string stringArgument(const ValuePtr& value, const std::string& name) {
+    auto string = value->asString();
+    if (!string) {
+        throw LispError(name + " requires a string argument.");
+    }
+    return *string;
+}
+
+const std::filesystem::path& scratchDirectory() {
+    static const std::filesystem::path directory = [] {
+        auto path = std::filesystem::temp_directory_path() / "mini-lisp-test";
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+        return path;
+    }();
+    return directory;
+}
+
+ValuePtr scratch(Arguments params, EvalEnv&) {
+    if (params.size() != 1) {
+        throw LispError("Scratch requires one argument.");
+    }
+    auto path = scratchDirectory() / stringArgument(params[0], "Scratch");
+    return makeValue<StringValue>(path.generic_string());
+}
+
+ValuePtr writeScript(Arguments params, EvalEnv&) {
+    if (params.size() != 2) {
+        throw LispError("Write-script requires two arguments.");
+    }
+    std::ofstream out(stringArgument(params[0], "Write-script"), std::ios::binary | std::ios::trunc);
+    for (const auto& form : params[1].toVector()) {
+        auto text = form->asString();
+        out << (text ? *text : form->toString()) << "\n";
+    }
+    if (!out) {
+        throw LispError("Write-script could not write the file.");
+    }
+    return ValuePtr::nil();
+}
+
+template <Engine engine, typename Source>
+ValuePtr runForms(Source& source) {
+    auto env = std::make_shared<EvalEnv>();
+    ValuePtr result = ValuePtr::nil();
+    while (auto form = source.read()) {
+        result = evaluate<engine>(*env, std::move(*form));
+    }
+    return result;
+}
+
+template <Engine engine>
+ValuePtr runCached(Arguments params, EvalEnv&) {
+    if (params.size() != 1) {
+        throw LispError("Run-cached requires one argument.");
+    }
+    auto path = stringArgument(params[0], "Run-cached");
+    MappedFile file(path);
+    auto cache = fasl::cachePath((scratchDirectory() / "cache").string(), path);
+    if (auto loader = fasl::Loader::open(cache, file)) {
+        return makeValue<PairValue>(ValuePtr::boolean(true), runForms<engine>(*loader));
+    }
+    fasl::Recorder recorder(file, cache);
+    return makeValue<PairValue>(ValuePtr::boolean(false), runForms<engine>(recorder));
+}
+
+template <Engine engine>
+ValuePtr inImage(Arguments params, EvalEnv&) {
+    if (params.size() != 2) {
+        throw LispError("In-image requires two arguments.");
+    }
+    auto env = std::make_shared<EvalEnv>();
+    image::load(stringArgument(params[0], "In-image"), env);
+    return evaluate<engine>(*env, params[1]);
+}
+
+}
+
+template <Engine engine>
+struct EngineTestCtx {
     std::shared_ptr<EvalEnv> env = std::make_shared<EvalEnv>();
+
+    EngineTestCtx() {
+        env->define(Symbol::intern("scratch"), makeValue<BuiltinProcValue>(&testing::scratch));
+        env->define(Symbol::intern("write-script"), makeValue<BuiltinProcValue>(&testing::writeScript));
+        env->define(Symbol::intern("run-cached"), makeValue<BuiltinProcValue>(&testing::runCached<engine>));
+        env->define(Symbol::intern("in-image"), makeValue<BuiltinProcValue>(&testing::inImage<engine>));
+    }
+
     std::string eval(std::string input) {
-        auto tokens = Tokenizer::tokenize(input);
-        Parser parser(std::move(tokens));
-        auto value = parser.parse();
-        return env->eval(std::move(value))->toString();
+        return evaluate<engine>(*env, Reader(input).read().value())->toString();
     }
 };
 
+using TestCtx = EngineTestCtx<Engine::TREE>;
+using VmTestCtx = EngineTestCtx<Engine::VM>;
+
 int main(int argc, char* argv[]) {
-#ifdef __TEST
-    RJSJ_TEST(TestCtx, Lv2, Lv3, Lv4, Lv5, Lv5Extra, Lv6, Lv7, Lv7Lib, Sicp);
+#if defined(__TEST) && defined(__TEST_VM)
+    RJSJ_TEST(VmTestCtx, Lv2, Lv3, Lv4, Lv5, Lv5Extra, Lv6, Lv7, Lv7Lib, Sicp, Eval, VmEval, Numbers,
+              Vectors, HashTables, Fasl, Image);
+#elif defined(__TEST)
+    RJSJ_TEST(TestCtx, Lv2, Lv3, Lv4, Lv5, Lv5Extra, Lv6, Lv7, Lv7Lib, Sicp, Eval, TreeEval, Numbers,
+              Vectors, HashTables, Fasl, Image);
 #endif
-    if (argc == 1) {
+    std::vector<std::string> argList(argv + 1, argv + argc);
+    Engine engine = Engine::TREE;
+    std::optional<std::string> cacheDirectory;
+    std::string image;
+    while (!argList.empty() && argList[0].starts_with("--")) {
+        if (argList[0].starts_with("--engine=")) {
+            auto name = argList[0].substr(std::string("--engine=").size());
+            if (name == "vm") {
+                engine = Engine::VM;
+            } else if (name != "tree") {
+                std::cerr << "Unknown engine " << name << ", expected tree or vm" << std::endl;
+                return 1;
+            }
+        } else if (argList[0] == "--cache") {
+            cacheDirectory = fasl::defaultDirectory();
+        } else if (argList[0].starts_with("--cache=")) {
+            cacheDirectory = argList[0].substr(std::string("--cache=").size());
+        } else if (argList[0].starts_with("--image=")) {
+            image = argList[0].substr(std::string("--image=").size());
+        } else if (argList[0] == "--image" && argList.size() > 1) {
+            argList.erase(argList.begin());
+            image = argList[0];
+        } else {
+            std::cerr << "Unknown option " << argList[0] << std::endl;
+            return 1;
+        }
+        argList.erase(argList.begin());
+    }
+
+    if (argList.empty()) {
         // REPL mode
         std::cout << "Welcome to Mini-Lisp Interpreter v1.0.0" << std::endl;
         std::cout << "Type \"(help)\" for more information, \"(exit n)\" to exit with code n."<< std::endl;
-        process(std::cin, true);
+        Reader reader(std::cin, [](size_t depth) {
+            if (depth == 0) {
+                std::cout << "\033[31m" << ">>> " << "\033[0m";
+            } else {
+                std::cout << "...";
+                for (size_t i = 0; i < depth; i++) {
+                    std::cout << "    ";
+                }
+            }
+        });
+        process(reader, true, engine, image);
     } else {
         // File mode
         std::vector<std::string> args;
-        if (argc > 2) {
-            std::string result(argv[1]);
+        if (argList.size() > 1) {
+            std::string result(argList[0]);
             size_t pos = 0;
             while ((pos = result.find('\\', pos)) != std::string::npos) {
                 result.insert(pos, "\\");
                 pos += 2; 
             }
             args.push_back(result);
-            for (int i = 2; i < argc; i++) {
-                args.push_back(std::string(argv[i]));
+            for (size_t i = 1; i < argList.size(); i++) {
+                args.push_back(argList[i]);
             }
         }
-        std::ifstream file(argv[1]);
-        if (!file) {
-            std::cerr << "Could not open file " << argv[1] << std::endl;
+        std::optional<MappedFile> file;
+        try {
+            file.emplace(argList[0]);
+        } catch (std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
             return 1;
         }
-        if (args.empty()) {
-            process(file, false);
+        if (!args.empty()) {
+            args = {std::to_string(args.size()), parseArgs(args)};
         } else {
-            process(file, false, std::vector({std::to_string(args.size()), parseArgs(args)}));
+            args = {"0", ""};
+        }
+        // With a cache directory, forms are read from the script's cache
+        // there, which is written while the script runs if it is missing
+        // or out of date.
+        if (cacheDirectory) {
+            auto cache = fasl::cachePath(*cacheDirectory, argList[0]);
+            if (auto loader = fasl::Loader::open(cache, *file)) {
+                process(*loader, false, engine, image, args);
+            } else {
+                fasl::Recorder recorder(*file, cache);
+                process(recorder, false, engine, image, args);
+            }
+            return 0;
         }
+        Reader reader(*file);
+        process(reader, false, engine, image, args);
     }
     return 0;
 }
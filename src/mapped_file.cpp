@@ -0,0 +1,105 @@
+#include "./mapped_file.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Could not open file " + path);
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    data = contents.data();
+    size = contents.size();
+}
+
+MappedFile::~MappedFile() {}
+
+void MappedFile::release(size_t begin, size_t end) {}
+
+#else
+
+namespace {
+
+bool readAll(int fd, std::string& contents) {
+    char buffer[1 << 16];
+    while (true) {
+        ssize_t count = ::read(fd, buffer, sizeof(buffer));
+        if (count == 0) {
+            return true;
+        } else if (count > 0) {
+            contents.append(buffer, static_cast<size_t>(count));
+        } else if (errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+}
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file " + path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || S_ISDIR(info.st_mode)) {
+        ::close(fd);
+        throw std::runtime_error("Could not open file " + path);
+    }
+    if (S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* mapping = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            ::madvise(mapping, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+            data = static_cast<const char*>(mapping);
+            size = static_cast<size_t>(info.st_size);
+            mapped = true;
+        }
+    }
+    // A pipe, a device or a file that could not be mapped is read through.
+    if (!mapped) {
+        if (!readAll(fd, contents)) {
+            ::close(fd);
+            throw std::runtime_error("Could not read file " + path);
+        }
+        data = contents.data();
+        size = contents.size();
+    }
+    // The mapping stays valid without the descriptor.
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (mapped) {
+        ::munmap(const_cast<char*>(data), size);
+    }
+}
+
+void MappedFile::release(size_t begin, size_t end) {
+    if (!mapped) {
+        return;
+    }
+    static const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    begin = begin / pageSize * pageSize;
+    end = std::min(end, size) / pageSize * pageSize;
+    if (end > begin) {
+        ::madvise(const_cast<char*>(data) + begin, end - begin, MADV_DONTNEED);
+    }
+}
+
+#endif
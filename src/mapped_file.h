@@ -0,0 +1,37 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+
+/**MappedFile class
+ * A file mapped read-only into memory for as long as the object lives, so
+ * the reader scans the page cache directly and processes running the same
+ * script share its pages. Pipes and other files that cannot be mapped,
+ * and every file where mmap is not available, are read into memory
+ * instead.
+ */
+class MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::string contents;
+
+public:
+    // Throws std::runtime_error if the file cannot be opened.
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    std::string_view view() const {
+        return {data, size};
+    }
+
+    // Gives the pages of [begin, end) back to the system, to be read from
+    // the file again if needed. Keeps a long script from staying resident
+    // once read.
+    void release(size_t begin, size_t end);
+};
+
+#endif
@@ -0,0 +1,256 @@
+#include <array>
+#include <typeinfo>
+
+#include "./analyzer.h"
+#include "./error.h"
+#include "./eval_env.h"
+#include "./node.h"
+
+ValuePtr evalBody(const std::vector<NodePtr>& body, EvalEnv& env) {
+    ValuePtr result;
+    for (const auto& expr : body) {
+        result = expr->eval(env);
+    }
+    return result;
+}
+
+ValuePtr evalBody(const std::vector<NodePtr>& body, EvalEnv& env, TailCall& tail) {
+    for (size_t i = 0; i + 1 < body.size(); i++) {
+        body[i]->eval(env);
+    }
+    return body.back()->evalTail(env, tail);
+}
+
+// Evaluates a node that has a tail position outside of one, running the
+// call it leaves pending, if any.
+ValuePtr evalThrough(const Node& node, EvalEnv& env) {
+    ValueStack::Mark mark;
+    TailCall tail;
+    if (auto result = node.evalTail(env, tail)) {
+        return result;
+    }
+    return tail.proc->call(ValueStack::top(tail.argc), env);
+}
+
+ValuePtr Node::evalTail(EvalEnv& env, TailCall& tail) const {
+    return eval(env);
+}
+
+ValuePtr ConstantNode::eval(EvalEnv& env) const {
+    return value;
+}
+
+ValuePtr GlobalVariableNode::eval(EvalEnv& env) const {
+    return global.load(env);
+}
+
+// A boxed variable is defined once its box holds a value.
+static const ValuePtr& unbox(const ValuePtr& slot, bool boxed) {
+    return boxed ? static_cast<const BoxValue*>(slot.get())->value : slot;
+}
+
+ValuePtr LocalVariableNode::eval(EvalEnv& env) const {
+    if (auto value = unbox(env.slot(binding.depth, binding.index), binding.boxed)) {
+        return value;
+    } else {
+        throw LispError("Variable " + name.name() + " not defined.");
+    }
+}
+
+ValuePtr CapturedVariableNode::eval(EvalEnv& env) const {
+    if (auto value = unbox(env.capture(binding.depth, binding.index), binding.boxed)) {
+        return value;
+    } else {
+        throw LispError("Variable " + name.name() + " not defined.");
+    }
+}
+
+ValuePtr GlobalDefineNode::eval(EvalEnv& env) const {
+    global.define(env, value->eval(env));
+    return ValuePtr::nil();
+}
+
+ValuePtr LocalDefineNode::eval(EvalEnv& env) const {
+    if (boxed) {
+        static_cast<BoxValue*>(env.slot(0, slot).get())->value = value->eval(env);
+    } else {
+        env.slot(0, slot) = value->eval(env);
+    }
+    return ValuePtr::nil();
+}
+
+ValuePtr IfNode::eval(EvalEnv& env) const {
+    return evalThrough(*this, env);
+}
+
+ValuePtr IfNode::evalTail(EvalEnv& env, TailCall& tail) const {
+    if (pred->eval(env)->asBoolean() == false) {
+        if (alternative) {
+            return alternative->evalTail(env, tail);
+        } else {
+            return ValuePtr::nil();
+        }
+    } else {
+        return consequent->evalTail(env, tail);
+    }
+}
+
+ValuePtr AndNode::eval(EvalEnv& env) const {
+    return evalThrough(*this, env);
+}
+
+ValuePtr AndNode::evalTail(EvalEnv& env, TailCall& tail) const {
+    if (exprs.empty()) {
+        return ValuePtr::boolean(true);
+    }
+
+    for (size_t i = 0; i + 1 < exprs.size(); i++) {
+        auto value = exprs[i]->eval(env);
+        if (!value->asBoolean()) {
+            return value;
+        }
+    }
+    return exprs.back()->evalTail(env, tail);
+}
+
+ValuePtr OrNode::eval(EvalEnv& env) const {
+    return evalThrough(*this, env);
+}
+
+ValuePtr OrNode::evalTail(EvalEnv& env, TailCall& tail) const {
+    if (exprs.empty()) {
+        return ValuePtr::boolean(false);
+    }
+
+    for (size_t i = 0; i + 1 < exprs.size(); i++) {
+        auto value = exprs[i]->eval(env);
+        if (value->asBoolean()) {
+            return value;
+        }
+    }
+    return exprs.back()->evalTail(env, tail);
+}
+
+ValuePtr CondNode::eval(EvalEnv& env) const {
+    return evalThrough(*this, env);
+}
+
+ValuePtr CondNode::evalTail(EvalEnv& env, TailCall& tail) const {
+    for (const auto& clause : clauses) {
+        if (!clause.test) {
+            return evalBody(clause.body, env, tail);
+        }
+        ValuePtr condition = clause.test->eval(env);
+        if (condition->asBoolean()) {
+            return clause.body.empty() ? condition : evalBody(clause.body, env, tail);
+        }
+    }
+    throw LispError("No true clause in cond.");
+}
+
+ValuePtr LetNode::eval(EvalEnv& env) const {
+    return evalThrough(*this, env);
+}
+
+ValuePtr LetNode::evalTail(EvalEnv& env, TailCall& tail) const {
+    size_t base = ValueStack::size();
+    for (const auto& init : initialValues) {
+        ValueStack::push(init->eval(env));
+    }
+    EvalEnv frame(env, scope, base);
+    return evalBody(body, frame, tail);
+}
+
+ValuePtr BeginNode::eval(EvalEnv& env) const {
+    return evalThrough(*this, env);
+}
+
+ValuePtr BeginNode::evalTail(EvalEnv& env, TailCall& tail) const {
+    if (body.empty()) {
+        return ValuePtr::nil();
+    }
+    return evalBody(body, env, tail);
+}
+
+// Boxes are captured as they are, so every closure shares them.
+void LambdaTemplate::analyze() const {
+    std::vector<Scope::Capture> captures;
+    for (auto name : restored) {
+        captures.push_back({name, false});
+    }
+    auto pair = static_cast<const PairValue*>(source.get());
+    auto exprs = pair->getCdr()->toVector();
+    auto analyzed = makeScope(parameterNames(pair->getCar()), exprs, nullptr, std::move(captures));
+    body = analyzeList(exprs, analyzed);
+    scope = std::move(analyzed);
+}
+
+std::vector<Symbol> LambdaTemplate::captureNames() const {
+    if (!scope) {
+        return restored;
+    }
+    std::vector<Symbol> result;
+    for (const auto& capture : scope->captures) {
+        result.push_back(capture.name);
+    }
+    return result;
+}
+
+ValuePtr LambdaNode::eval(EvalEnv& env) const {
+    ValueVector values;
+    values.reserve(captures.size());
+    for (const auto& capture : captures) {
+        values.push_back(capture.captured ? env.capture(capture.depth, capture.index)
+                                          : env.slot(capture.depth, capture.index));
+    }
+    return makeValue<LambdaValue>(code, std::move(values));
+}
+
+// A builtin with a direct entry for this many arguments gets them in a
+// local array instead of a vector.
+static ValuePtr callFixed(const BuiltinProcValue& builtin, const std::vector<NodePtr>& args, EvalEnv& env) {
+    std::array<ValuePtr, BuiltinProcValue::MAX_FIXED_ARITY> argValues;
+    for (size_t i = 0; i < args.size(); i++) {
+        argValues[i] = args[i]->eval(env);
+    }
+    return builtin.callFixed(argValues.data());
+}
+
+ValuePtr CallNode::eval(EvalEnv& env) const {
+    ValuePtr procValue = proc->eval(env);
+    if (auto builtin = BuiltinProcValue::withArity(procValue, args.size())) {
+        return callFixed(*builtin, args, env);
+    }
+    ValueStack::Mark mark;
+    for (const auto& arg : args) {
+        ValueStack::push(arg->eval(env));
+    }
+    return env.apply(procValue, ValueStack::top(args.size()));
+}
+
+// Only lambdas are deferred: builtins such as eval see the frame they are
+// called from, which is gone once the pending call runs. The arguments of
+// a deferred call stay pushed for the caller of evalTail to pop.
+ValuePtr CallNode::evalTail(EvalEnv& env, TailCall& tail) const {
+    ValuePtr procValue = proc->eval(env);
+    if (auto builtin = BuiltinProcValue::withArity(procValue, args.size())) {
+        return callFixed(*builtin, args, env);
+    }
+    if (!procValue.get() || typeid(*procValue.get()) != typeid(LambdaValue)) {
+        ValueStack::Mark mark;
+        for (const auto& arg : args) {
+            ValueStack::push(arg->eval(env));
+        }
+        return env.apply(procValue, ValueStack::top(args.size()));
+    }
+    for (const auto& arg : args) {
+        ValueStack::push(arg->eval(env));
+    }
+    tail.proc = std::move(procValue);
+    tail.argc = args.size();
+    return nullptr;
+}
+
+ValuePtr QuasiquoteNode::eval(EvalEnv& env) const {
+    return makeValue<PairValue>(car->eval(env), cdr->eval(env));
+}
@@ -0,0 +1,267 @@
+#ifndef NODE_H
+#define NODE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "./eval_env.h"
+#include "./scope.h"
+#include "./value.h"
+
+// A call to a lambda in tail position, left for LambdaValue::call to run
+// in place of the call that is returning. Its arguments are the top
+// `argc` values of the ValueStack.
+struct TailCall {
+    ValuePtr proc;
+    size_t argc = 0;
+};
+
+/**Node class
+ * A form after syntax analysis. Each special form is dispatched once when
+ * the form is analyzed, so evaluating a node never re-inspects cons cells.
+ * evalTail evaluates a node in tail position: it may store a pending call
+ * in `tail` and return nullptr instead of making the call itself.
+ */
+class Node {
+public:
+    virtual ~Node() = default;
+
+    virtual ValuePtr eval(EvalEnv& env) const = 0;
+    virtual ValuePtr evalTail(EvalEnv& env, TailCall& tail) const;
+};
+
+using NodePtr = std::shared_ptr<Node>;
+
+ValuePtr evalBody(const std::vector<NodePtr>& body, EvalEnv& env);
+ValuePtr evalBody(const std::vector<NodePtr>& body, EvalEnv& env, TailCall& tail);
+
+
+class ConstantNode : public Node {
+    ValuePtr value;
+
+public:
+    ConstantNode(ValuePtr value) : value{value} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+};
+
+
+class GlobalVariableNode : public Node {
+    mutable GlobalReference global;
+
+public:
+    GlobalVariableNode(Symbol name) : global{name} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+};
+
+
+// A parameter, let binding or internal define, `depth` frames up.
+class LocalVariableNode : public Node {
+    Symbol name;
+    LocalBinding binding;
+
+public:
+    LocalVariableNode(Symbol name, LocalBinding binding) : name{name}, binding{binding} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+};
+
+
+// A variable the running closure captured, see Scope.
+class CapturedVariableNode : public Node {
+    Symbol name;
+    LocalBinding binding;
+
+public:
+    CapturedVariableNode(Symbol name, LocalBinding binding) : name{name}, binding{binding} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+};
+
+
+class GlobalDefineNode : public Node {
+    mutable GlobalReference global;
+    NodePtr value;
+
+public:
+    GlobalDefineNode(Symbol name, NodePtr value) : global{name}, value{value} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+};
+
+
+class LocalDefineNode : public Node {
+    size_t slot;
+    bool boxed;
+    NodePtr value;
+
+public:
+    LocalDefineNode(size_t slot, bool boxed, NodePtr value) : slot{slot}, boxed{boxed}, value{value} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+};
+
+
+class IfNode : public Node {
+    NodePtr pred;
+    NodePtr consequent;
+    NodePtr alternative;
+
+public:
+    IfNode(NodePtr pred, NodePtr consequent, NodePtr alternative) :
+        pred{pred}, consequent{consequent}, alternative{alternative} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+    ValuePtr evalTail(EvalEnv& env, TailCall& tail) const override;
+};
+
+
+class AndNode : public Node {
+    std::vector<NodePtr> exprs;
+
+public:
+    AndNode(const std::vector<NodePtr>& exprs) : exprs{exprs} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+    ValuePtr evalTail(EvalEnv& env, TailCall& tail) const override;
+};
+
+
+class OrNode : public Node {
+    std::vector<NodePtr> exprs;
+
+public:
+    OrNode(const std::vector<NodePtr>& exprs) : exprs{exprs} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+    ValuePtr evalTail(EvalEnv& env, TailCall& tail) const override;
+};
+
+
+class CondNode : public Node {
+public:
+    struct Clause {
+        NodePtr test;   // nullptr for the else clause
+        std::vector<NodePtr> body;
+    };
+
+private:
+    std::vector<Clause> clauses;
+
+public:
+    CondNode(const std::vector<Clause>& clauses) : clauses{clauses} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+    ValuePtr evalTail(EvalEnv& env, TailCall& tail) const override;
+};
+
+
+class LetNode : public Node {
+    ScopePtr scope;
+    std::vector<NodePtr> initialValues;
+    std::vector<NodePtr> body;
+
+public:
+    LetNode(ScopePtr scope,
+            const std::vector<NodePtr>& initialValues,
+            const std::vector<NodePtr>& body) :
+        scope{scope}, initialValues{initialValues}, body{body} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+    ValuePtr evalTail(EvalEnv& env, TailCall& tail) const override;
+};
+
+
+class BeginNode : public Node {
+    std::vector<NodePtr> body;
+
+public:
+    BeginNode(const std::vector<NodePtr>& body) : body{body} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+    ValuePtr evalTail(EvalEnv& env, TailCall& tail) const override;
+};
+
+
+// The code of a lambda expression, shared by every closure made from it.
+// One restored from an image has only its source and the names of its
+// captures, in the order of the closures' captures, until its first call
+// analyzes it.
+class LambdaTemplate {
+    mutable ScopePtr scope;
+    mutable std::vector<NodePtr> body;
+    ValuePtr source;    // (params . body), kept to save closures in an image
+    std::vector<Symbol> restored;
+
+    void analyze() const;
+
+public:
+    LambdaTemplate(ScopePtr scope, std::vector<NodePtr> body, ValuePtr source) :
+        scope{std::move(scope)}, body{std::move(body)}, source{std::move(source)} {}
+    LambdaTemplate(ValuePtr source, std::vector<Symbol> captures) :
+        source{std::move(source)}, restored{std::move(captures)} {}
+
+    const ScopePtr& getScope() const {
+        if (!scope) {
+            analyze();
+        }
+        return scope;
+    }
+    const std::vector<NodePtr>& getBody() const {
+        if (!scope) {
+            analyze();
+        }
+        return body;
+    }
+    const ValuePtr& getSource() const {
+        return source;
+    }
+    std::vector<Symbol> captureNames() const;
+};
+
+
+// Makes a closure of its template, capturing the variables listed in the
+// template's scope from where the enclosing frame finds them.
+class LambdaNode : public Node {
+    std::shared_ptr<const LambdaTemplate> code;
+    std::vector<LocalBinding> captures;
+
+public:
+    LambdaNode(std::shared_ptr<const LambdaTemplate> code, std::vector<LocalBinding> captures) :
+        code{std::move(code)}, captures{std::move(captures)} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+
+    const std::shared_ptr<const LambdaTemplate>& getTemplate() const {
+        return code;
+    }
+};
+
+
+class CallNode : public Node {
+    NodePtr proc;
+    std::vector<NodePtr> args;
+
+public:
+    CallNode(NodePtr proc, const std::vector<NodePtr>& args) : proc{proc}, args{args} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+    ValuePtr evalTail(EvalEnv& env, TailCall& tail) const override;
+};
+
+
+// Builds one cons cell of a quasiquote template; unquoted parts are
+// ordinary nodes, everything else is a ConstantNode.
+class QuasiquoteNode : public Node {
+    NodePtr car;
+    NodePtr cdr;
+
+public:
+    QuasiquoteNode(NodePtr car, NodePtr cdr) : car{car}, cdr{cdr} {}
+
+    ValuePtr eval(EvalEnv& env) const override;
+};
+
+#endif
@@ -0,0 +1,553 @@
+#include "./number.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+#include "./error.h"
+
+namespace {
+
+using Digits = std::vector<uint32_t>;
+
+constexpr uint64_t BASE = uint64_t{1} << 32;
+constexpr uint32_t DECIMAL_BASE = 1000000000;
+constexpr int DECIMAL_DIGITS = 9;
+
+/**Integer struct
+ * An exact integer being computed on: a sign and a magnitude in the
+ * digits of BigIntValue. Zero has no digits and is never negative.
+ */
+struct Integer {
+    bool negative = false;
+    Digits digits;
+};
+
+void trim(Digits& digits) {
+    while (!digits.empty() && digits.back() == 0) {
+        digits.pop_back();
+    }
+}
+
+Integer fromInt64(int64_t value) {
+    Integer result;
+    result.negative = value < 0;
+    // Negating in unsigned arithmetic is defined for INT64_MIN too.
+    uint64_t magnitude = result.negative ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    while (magnitude != 0) {
+        result.digits.push_back(static_cast<uint32_t>(magnitude));
+        magnitude >>= 32;
+    }
+    return result;
+}
+
+Integer toInteger(const ValuePtr& value) {
+    if (value->isFixnum()) {
+        return fromInt64(value->getFixnum());
+    }
+    auto big = static_cast<BigIntValue*>(value.get());
+    return {big->isNegative(), big->getDigits()};
+}
+
+// Back to a value, as a fixnum whenever it fits.
+ValuePtr toValue(Integer&& integer) {
+    trim(integer.digits);
+    if (integer.digits.size() <= 2) {
+        uint64_t magnitude = 0;
+        for (size_t i = integer.digits.size(); i > 0; i--) {
+            magnitude = magnitude << 32 | integer.digits[i - 1];
+        }
+        if (magnitude <= static_cast<uint64_t>(ValuePtr::FIXNUM_MAX) + integer.negative) {
+            auto value = static_cast<int64_t>(magnitude);
+            return ValuePtr::fixnum(integer.negative ? -value : value);
+        }
+    }
+    return makeValue<BigIntValue>(integer.negative && !integer.digits.empty(), std::move(integer.digits));
+}
+
+double toDouble(const Digits& digits, bool negative) {
+    double result = 0;
+    for (size_t i = digits.size(); i > 0; i--) {
+        result = result * static_cast<double>(BASE) + digits[i - 1];
+    }
+    return negative ? -result : result;
+}
+
+int compareMagnitude(const Digits& left, const Digits& right) {
+    if (left.size() != right.size()) {
+        return left.size() < right.size() ? -1 : 1;
+    }
+    for (size_t i = left.size(); i > 0; i--) {
+        if (left[i - 1] != right[i - 1]) {
+            return left[i - 1] < right[i - 1] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+Digits addMagnitude(const Digits& left, const Digits& right) {
+    const Digits& longer = left.size() >= right.size() ? left : right;
+    const Digits& shorter = left.size() >= right.size() ? right : left;
+    Digits result(longer.size() + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < longer.size(); i++) {
+        uint64_t sum = carry + longer[i] + (i < shorter.size() ? shorter[i] : 0);
+        result[i] = static_cast<uint32_t>(sum);
+        carry = sum >> 32;
+    }
+    result[longer.size()] = static_cast<uint32_t>(carry);
+    trim(result);
+    return result;
+}
+
+// The magnitude of left must not be below that of right.
+Digits subtractMagnitude(const Digits& left, const Digits& right) {
+    Digits result(left.size());
+    int64_t borrow = 0;
+    for (size_t i = 0; i < left.size(); i++) {
+        int64_t difference = static_cast<int64_t>(left[i]) - borrow - (i < right.size() ? right[i] : 0);
+        borrow = difference < 0;
+        result[i] = static_cast<uint32_t>(difference);
+    }
+    trim(result);
+    return result;
+}
+
+Digits multiplyMagnitude(const Digits& left, const Digits& right) {
+    if (left.empty() || right.empty()) {
+        return {};
+    }
+    Digits result(left.size() + right.size());
+    for (size_t i = 0; i < left.size(); i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < right.size(); j++) {
+            uint64_t product = static_cast<uint64_t>(left[i]) * right[j] + result[i + j] + carry;
+            result[i + j] = static_cast<uint32_t>(product);
+            carry = product >> 32;
+        }
+        result[i + right.size()] = static_cast<uint32_t>(carry);
+    }
+    trim(result);
+    return result;
+}
+
+// Divides digits in place by a single digit and returns the remainder.
+uint32_t divideSmall(Digits& digits, uint32_t divisor) {
+    uint64_t remainder = 0;
+    for (size_t i = digits.size(); i > 0; i--) {
+        uint64_t current = remainder << 32 | digits[i - 1];
+        digits[i - 1] = static_cast<uint32_t>(current / divisor);
+        remainder = current % divisor;
+    }
+    trim(digits);
+    return static_cast<uint32_t>(remainder);
+}
+
+void multiplySmall(Digits& digits, uint32_t factor, uint32_t addend) {
+    uint64_t carry = addend;
+    for (auto& digit : digits) {
+        uint64_t product = static_cast<uint64_t>(digit) * factor + carry;
+        digit = static_cast<uint32_t>(product);
+        carry = product >> 32;
+    }
+    if (carry != 0) {
+        digits.push_back(static_cast<uint32_t>(carry));
+    }
+}
+
+// Truncating division of magnitudes, Knuth's algorithm D. The divisor
+// must not be zero.
+std::pair<Digits, Digits> divideMagnitude(const Digits& left, const Digits& right) {
+    if (compareMagnitude(left, right) < 0) {
+        return {{}, left};
+    }
+    if (right.size() == 1) {
+        Digits quotient = left;
+        uint32_t remainder = divideSmall(quotient, right[0]);
+        return {quotient, remainder == 0 ? Digits{} : Digits{remainder}};
+    }
+
+    // Shift both so the top digit of the divisor has its high bit set,
+    // which keeps every estimated quotient digit at most two too large.
+    int shift = std::countl_zero(right.back());
+    size_t n = right.size();
+    size_t m = left.size() - n;
+    Digits v(n);
+    Digits u(left.size() + 1);
+    for (size_t i = n; i > 0; i--) {
+        uint64_t lower = i > 1 ? right[i - 2] : 0;
+        v[i - 1] = static_cast<uint32_t>((static_cast<uint64_t>(right[i - 1]) << shift) | (lower << shift >> 32));
+    }
+    u[left.size()] = static_cast<uint32_t>(static_cast<uint64_t>(left.back()) << shift >> 32);
+    for (size_t i = left.size(); i > 0; i--) {
+        uint64_t lower = i > 1 ? left[i - 2] : 0;
+        u[i - 1] = static_cast<uint32_t>((static_cast<uint64_t>(left[i - 1]) << shift) | (lower << shift >> 32));
+    }
+
+    Digits quotient(m + 1);
+    for (size_t j = m + 1; j > 0; j--) {
+        size_t k = j - 1;
+        uint64_t top = static_cast<uint64_t>(u[k + n]) << 32 | u[k + n - 1];
+        uint64_t estimate = top / v[n - 1];
+        uint64_t rest = top % v[n - 1];
+        while (estimate >= BASE || estimate * v[n - 2] > (rest << 32 | u[k + n - 2])) {
+            estimate--;
+            rest += v[n - 1];
+            if (rest >= BASE) {
+                break;
+            }
+        }
+
+        int64_t borrow = 0;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t product = estimate * v[i] + carry;
+            carry = product >> 32;
+            int64_t difference = static_cast<int64_t>(u[i + k]) - borrow - static_cast<int64_t>(product & 0xffffffff);
+            u[i + k] = static_cast<uint32_t>(difference);
+            borrow = difference < 0;
+        }
+        int64_t difference = static_cast<int64_t>(u[k + n]) - borrow - static_cast<int64_t>(carry);
+        u[k + n] = static_cast<uint32_t>(difference);
+
+        // The estimate was one too large: add the divisor back.
+        if (difference < 0) {
+            estimate--;
+            uint64_t sum = 0;
+            for (size_t i = 0; i < n; i++) {
+                sum = static_cast<uint64_t>(u[i + k]) + v[i] + (sum >> 32);
+                u[i + k] = static_cast<uint32_t>(sum);
+            }
+            u[k + n] += static_cast<uint32_t>(sum >> 32);
+        }
+        quotient[k] = static_cast<uint32_t>(estimate);
+    }
+
+    Digits remainder(n);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t upper = static_cast<uint64_t>(u[i + 1]) << 32;
+        remainder[i] = static_cast<uint32_t>((upper | u[i]) >> shift);
+    }
+    trim(quotient);
+    trim(remainder);
+    return {quotient, remainder};
+}
+
+Integer add(const Integer& left, const Integer& right) {
+    if (left.negative == right.negative) {
+        return {left.negative, addMagnitude(left.digits, right.digits)};
+    }
+    if (compareMagnitude(left.digits, right.digits) >= 0) {
+        return {left.negative, subtractMagnitude(left.digits, right.digits)};
+    }
+    return {right.negative, subtractMagnitude(right.digits, left.digits)};
+}
+
+Integer negated(Integer integer) {
+    integer.negative = !integer.negative && !integer.digits.empty();
+    return integer;
+}
+
+int compare(const Integer& left, const Integer& right) {
+    if (left.negative != right.negative) {
+        return left.negative ? -1 : 1;
+    }
+    int result = compareMagnitude(left.digits, right.digits);
+    return left.negative ? -result : result;
+}
+
+// An integral double as an exact integer.
+Integer fromDouble(double value) {
+    if (std::abs(value) < 0x1p63) {
+        return fromInt64(static_cast<int64_t>(value));
+    }
+    int exponent;
+    double fraction = std::frexp(std::abs(value), &exponent);
+    Integer result = fromInt64(static_cast<int64_t>(std::ldexp(fraction, 53)));
+    for (int i = 0; i < exponent - 53; i++) {
+        multiplySmall(result.digits, 2, 0);
+    }
+    result.negative = value < 0;
+    return result;
+}
+
+bool isIntegral(double value) {
+    return std::isfinite(value) && std::trunc(value) == value;
+}
+
+double flonumValue(const ValuePtr& value) {
+    return value->asNumber().value();
+}
+
+void requireInteger(const ValuePtr& value) {
+    if (!numbers::isInteger(value)) {
+        throw LispError("Cannot divide a non-integer value.");
+    }
+}
+
+void requireNonZero(const ValuePtr& value) {
+    if (numbers::isZero(value)) {
+        throw LispError("Cannot divide by zero.");
+    }
+}
+
+std::pair<Integer, Integer> divideInteger(const Integer& left, const Integer& right) {
+    auto [quotient, remainder] = divideMagnitude(left.digits, right.digits);
+    Integer q{left.negative != right.negative && !quotient.empty(), std::move(quotient)};
+    Integer r{left.negative && !remainder.empty(), std::move(remainder)};
+    return {std::move(q), std::move(r)};
+}
+
+}
+
+
+/**BigIntValue class
+ * Methods of exact integers outside the fixnum range
+ */
+std::string BigIntValue::toString() const {
+    Digits rest = digits;
+    std::vector<uint32_t> chunks;
+    while (!rest.empty()) {
+        chunks.push_back(divideSmall(rest, DECIMAL_BASE));
+    }
+    std::string result = negative ? "-" : "";
+    result += std::to_string(chunks.back());
+    for (size_t i = chunks.size() - 1; i > 0; i--) {
+        std::string chunk = std::to_string(chunks[i - 1]);
+        result += std::string(DECIMAL_DIGITS - chunk.size(), '0') + chunk;
+    }
+    return result;
+}
+
+std::optional<double> BigIntValue::asNumber() const {
+    return toDouble(digits, negative);
+}
+
+
+/**Numeric tower
+ * Operations beyond the fixnum fast paths
+ */
+namespace numbers {
+
+bool isExact(const ValuePtr& value) {
+    return !value->isFlonum();
+}
+
+bool isInteger(const ValuePtr& value) {
+    return isExact(value) || isIntegral(flonumValue(value));
+}
+
+ValuePtr addSlow(const ValuePtr& left, const ValuePtr& right) {
+    if (!isExact(left) || !isExact(right)) {
+        return ValuePtr::number(flonumValue(left) + flonumValue(right));
+    }
+    return toValue(::add(toInteger(left), toInteger(right)));
+}
+
+ValuePtr subtractSlow(const ValuePtr& left, const ValuePtr& right) {
+    if (!isExact(left) || !isExact(right)) {
+        return ValuePtr::number(flonumValue(left) - flonumValue(right));
+    }
+    return toValue(::add(toInteger(left), negated(toInteger(right))));
+}
+
+ValuePtr multiplySlow(const ValuePtr& left, const ValuePtr& right) {
+    if (!isExact(left) || !isExact(right)) {
+        return ValuePtr::number(flonumValue(left) * flonumValue(right));
+    }
+    Integer a = toInteger(left);
+    Integer b = toInteger(right);
+    return toValue({a.negative != b.negative, multiplyMagnitude(a.digits, b.digits)});
+}
+
+std::partial_ordering compareSlow(const ValuePtr& left, const ValuePtr& right) {
+    if (left->isFlonum() && right->isFlonum()) {
+        return flonumValue(left) <=> flonumValue(right);
+    }
+    if (right->isFlonum()) {
+        return 0 <=> compareSlow(right, left);
+    }
+    if (left->isFlonum()) {
+        // Compare exactly: a bignum may not survive the trip to a double.
+        double number = flonumValue(left);
+        if (std::isnan(number)) {
+            return std::partial_ordering::unordered;
+        } else if (std::isinf(number)) {
+            return number < 0 ? std::partial_ordering::less : std::partial_ordering::greater;
+        }
+        int result = ::compare(fromDouble(std::floor(number)), toInteger(right));
+        if (result == 0 && std::floor(number) != number) {
+            return std::partial_ordering::greater;
+        }
+        return result <=> 0;
+    }
+    return ::compare(toInteger(left), toInteger(right)) <=> 0;
+}
+
+bool eqv(const ValuePtr& left, const ValuePtr& right) {
+    return isExact(left) == isExact(right) && compare(left, right) == 0;
+}
+
+size_t hash(const ValuePtr& value) {
+    if (value->isFixnum()) {
+        return std::hash<int64_t>{}(value->getFixnum());
+    } else if (value->isFlonum()) {
+        // 0.0 and -0.0 are equal, so they must hash alike.
+        double number = flonumValue(value);
+        return std::hash<double>{}(number == 0 ? 0.0 : number);
+    }
+    auto big = static_cast<BigIntValue*>(value.get());
+    size_t result = big->isNegative();
+    for (auto digit : big->getDigits()) {
+        result = result * 0x100000001b3 ^ digit;
+    }
+    return result;
+}
+
+ValuePtr negate(const ValuePtr& value) {
+    return subtract(ValuePtr::fixnum(0), value);
+}
+
+ValuePtr abs(const ValuePtr& value) {
+    if (value->isFlonum()) {
+        return ValuePtr::number(std::abs(flonumValue(value)));
+    }
+    return compare(value, ValuePtr::fixnum(0)) < 0 ? negate(value) : value;
+}
+
+ValuePtr divide(const ValuePtr& left, const ValuePtr& right) {
+    requireNonZero(right);
+    if (isExact(left) && isExact(right)) {
+        auto [quotient, remainder] = divideInteger(toInteger(left), toInteger(right));
+        if (remainder.digits.empty()) {
+            return toValue(std::move(quotient));
+        }
+    }
+    return ValuePtr::number(flonumValue(left) / flonumValue(right));
+}
+
+ValuePtr expt(const ValuePtr& base, const ValuePtr& exponent) {
+    if (isZero(base) && compare(exponent, ValuePtr::fixnum(0)) <= 0) {
+        throw LispError("Cannot raise zero to a non-positive power.");
+    }
+    if (isExact(base) && exponent->isFixnum() && exponent->getFixnum() >= 0) {
+        ValuePtr result = ValuePtr::fixnum(1);
+        ValuePtr square = base;
+        for (int64_t n = exponent->getFixnum(); n > 0; n >>= 1) {
+            if (n & 1) {
+                result = multiply(result, square);
+            }
+            if (n > 1) {
+                square = multiply(square, square);
+            }
+        }
+        return result;
+    }
+    return ValuePtr::number(std::pow(flonumValue(base), flonumValue(exponent)));
+}
+
+ValuePtr quotient(const ValuePtr& left, const ValuePtr& right) {
+    requireInteger(left);
+    requireInteger(right);
+    requireNonZero(right);
+    if (left->isFixnum() && right->isFixnum()) {
+        return integer(left->getFixnum() / right->getFixnum());
+    } else if (isExact(left) && isExact(right)) {
+        return toValue(divideInteger(toInteger(left), toInteger(right)).first);
+    }
+    return ValuePtr::number(std::trunc(flonumValue(left) / flonumValue(right)));
+}
+
+ValuePtr remainder(const ValuePtr& left, const ValuePtr& right) {
+    requireInteger(left);
+    requireInteger(right);
+    requireNonZero(right);
+    if (left->isFixnum() && right->isFixnum()) {
+        return ValuePtr::fixnum(left->getFixnum() % right->getFixnum());
+    } else if (isExact(left) && isExact(right)) {
+        return toValue(divideInteger(toInteger(left), toInteger(right)).second);
+    }
+    return ValuePtr::number(std::fmod(flonumValue(left), flonumValue(right)));
+}
+
+ValuePtr modulo(const ValuePtr& left, const ValuePtr& right) {
+    ValuePtr result = remainder(left, right);
+    if (!isZero(result) && (compare(result, ValuePtr::fixnum(0)) < 0) != (compare(right, ValuePtr::fixnum(0)) < 0)) {
+        result = add(result, right);
+    }
+    return result;
+}
+
+bool isZero(const ValuePtr& value) {
+    if (value->isFixnum()) {
+        return value->getFixnum() == 0;
+    }
+    // A bignum is never zero.
+    return value->isFlonum() && flonumValue(value) == 0;
+}
+
+bool isEven(const ValuePtr& value) {
+    if (value->isFixnum()) {
+        return value->getFixnum() % 2 == 0;
+    } else if (value->isFlonum()) {
+        return std::fmod(flonumValue(value), 2) == 0;
+    }
+    return static_cast<BigIntValue*>(value.get())->getDigits()[0] % 2 == 0;
+}
+
+ValuePtr integer(int64_t value) {
+    if (value >= ValuePtr::FIXNUM_MIN && value <= ValuePtr::FIXNUM_MAX) {
+        return ValuePtr::fixnum(value);
+    }
+    return toValue(fromInt64(value));
+}
+
+ValuePtr fromLiteral(std::string_view text, double value) {
+    std::string_view digits = text;
+    if (!digits.empty() && (digits[0] == '+' || digits[0] == '-')) {
+        digits.remove_prefix(1);
+    }
+    if (digits.empty() || !std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        return ValuePtr::number(value);
+    }
+    Integer result;
+    for (size_t i = 0; i < digits.size(); i += DECIMAL_DIGITS) {
+        size_t length = std::min<size_t>(DECIMAL_DIGITS, digits.size() - i);
+        uint32_t chunk = 0;
+        std::from_chars(digits.data() + i, digits.data() + i + length, chunk);
+        uint32_t scale = 1;
+        for (size_t j = 0; j < length; j++) {
+            scale *= 10;
+        }
+        multiplySmall(result.digits, scale, chunk);
+    }
+    trim(result.digits);
+    result.negative = text[0] == '-' && !result.digits.empty();
+    return toValue(std::move(result));
+}
+
+std::string flonumToString(double value) {
+    if (std::isnan(value)) {
+        return "+nan.0";
+    } else if (std::isinf(value)) {
+        return value < 0 ? "-inf.0" : "+inf.0";
+    }
+    // The shortest digits that read back the same, in fixed notation unless
+    // the value is too large or too small to write that way readably.
+    double magnitude = std::fabs(value);
+    auto format = magnitude == 0 || (magnitude >= 1e-7 && magnitude < 1e21) ? std::chars_format::fixed
+                                                                              : std::chars_format::scientific;
+    char buffer[64];
+    auto end = std::to_chars(buffer, buffer + sizeof(buffer), value, format).ptr;
+    std::string result(buffer, end);
+    if (result.find_first_of(".e") == std::string::npos) {
+        result += ".0";
+    }
+    return result;
+}
+
+}
+
+ValuePtr ValuePtr::integer(int64_t value) {
+    return numbers::integer(value);
+}
@@ -0,0 +1,128 @@
+#ifndef NUMBER_H
+#define NUMBER_H
+
+#include <compare>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "./value.h"
+
+/**BigIntValue class
+ * An exact integer outside the fixnum range: its sign and its magnitude
+ * in base 2^32 digits, least significant first, without leading zeros.
+ * Results that fit a fixnum again are always returned as one, so a
+ * BigIntValue is never equal to a fixnum.
+ */
+class BigIntValue : public Value {
+    bool negative;
+    std::vector<uint32_t> digits;
+
+public:
+    BigIntValue(bool negative, std::vector<uint32_t> digits) :
+        Value(ValueType::NUMERIC), negative{negative}, digits{std::move(digits)} {}
+
+    bool isNegative() const {
+        return negative;
+    }
+    const std::vector<uint32_t>& getDigits() const {
+        return digits;
+    }
+
+    std::string toString() const override;
+    std::optional<double> asNumber() const override;
+};
+
+
+/**Numeric tower
+ * A number is an exact integer, a fixnum or else a BigIntValue, or an
+ * inexact flonum. Operations on exact integers are exact and promote to
+ * bignums when a result outgrows a fixnum; a flonum operand makes the
+ * result a flonum. Division of exact integers is exact when it leaves no
+ * remainder and a flonum otherwise, as there are no rationals. The
+ * fixnum cases are inline, everything else is handled out of line.
+ * Operands must be numbers; errors throw LispError.
+ */
+namespace numbers {
+
+bool isExact(const ValuePtr& value);
+// An exact integer, or a flonum with an integral value.
+bool isInteger(const ValuePtr& value);
+
+ValuePtr addSlow(const ValuePtr& left, const ValuePtr& right);
+ValuePtr subtractSlow(const ValuePtr& left, const ValuePtr& right);
+ValuePtr multiplySlow(const ValuePtr& left, const ValuePtr& right);
+std::partial_ordering compareSlow(const ValuePtr& left, const ValuePtr& right);
+
+inline ValuePtr add(const ValuePtr& left, const ValuePtr& right) {
+    if (left->isFixnum() && right->isFixnum()) {
+        int64_t result = left->getFixnum() + right->getFixnum();
+        if (result >= ValuePtr::FIXNUM_MIN && result <= ValuePtr::FIXNUM_MAX) {
+            return ValuePtr::fixnum(result);
+        }
+    }
+    return addSlow(left, right);
+}
+
+inline ValuePtr subtract(const ValuePtr& left, const ValuePtr& right) {
+    if (left->isFixnum() && right->isFixnum()) {
+        int64_t result = left->getFixnum() - right->getFixnum();
+        if (result >= ValuePtr::FIXNUM_MIN && result <= ValuePtr::FIXNUM_MAX) {
+            return ValuePtr::fixnum(result);
+        }
+    }
+    return subtractSlow(left, right);
+}
+
+inline ValuePtr multiply(const ValuePtr& left, const ValuePtr& right) {
+    // Factors below 2^31 cannot overflow 64 bits.
+    constexpr int64_t LIMIT = int64_t{1} << 31;
+    if (left->isFixnum() && right->isFixnum()) {
+        int64_t a = left->getFixnum();
+        int64_t b = right->getFixnum();
+        if (a > -LIMIT && a < LIMIT && b > -LIMIT && b < LIMIT) {
+            int64_t result = a * b;
+            if (result >= ValuePtr::FIXNUM_MIN && result <= ValuePtr::FIXNUM_MAX) {
+                return ValuePtr::fixnum(result);
+            }
+        }
+    }
+    return multiplySlow(left, right);
+}
+
+// Unordered if either number is a NaN.
+inline std::partial_ordering compare(const ValuePtr& left, const ValuePtr& right) {
+    if (left->isFixnum() && right->isFixnum()) {
+        return left->getFixnum() <=> right->getFixnum();
+    }
+    return compareSlow(left, right);
+}
+
+// eqv? of two numbers: the same exactness and the same value.
+bool eqv(const ValuePtr& left, const ValuePtr& right);
+size_t hash(const ValuePtr& value);
+
+ValuePtr negate(const ValuePtr& value);
+ValuePtr abs(const ValuePtr& value);
+ValuePtr divide(const ValuePtr& left, const ValuePtr& right);
+ValuePtr expt(const ValuePtr& base, const ValuePtr& exponent);
+
+// Division of integers: quotient truncates, remainder takes the sign of
+// the dividend and modulo that of the divisor.
+ValuePtr quotient(const ValuePtr& left, const ValuePtr& right);
+ValuePtr remainder(const ValuePtr& left, const ValuePtr& right);
+ValuePtr modulo(const ValuePtr& left, const ValuePtr& right);
+
+bool isZero(const ValuePtr& value);
+bool isEven(const ValuePtr& value);
+
+ValuePtr integer(int64_t value);
+// The value of a numeric literal the tokenizer read as value: exact if it
+// is written as an integer, however long.
+ValuePtr fromLiteral(std::string_view text, double value);
+std::string flonumToString(double value);
+
+}
+
+#endif
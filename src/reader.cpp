@@ -0,0 +1,152 @@
+#include "./reader.h"
+
+#include <algorithm>
+
+#include "./error.h"
+#include "./number.h"
+
+constexpr size_t RELEASE_STEP = 1 << 20;
+
+Reader::Reader(std::string_view input) : input{input}, tokenizer{input} {}
+
+Reader::Reader(MappedFile& file) : file{&file}, input{file.view()}, tokenizer{input} {}
+
+Reader::Reader(std::istream& stream, std::function<void(size_t)> onLine) :
+    stream{&stream}, tokenizer{{}, true}, onLine{std::move(onLine)} {}
+
+// Replaces the consumed part of the buffer with the next line of the
+// stream. Only a string literal cut off by the end of a line is left.
+bool Reader::readLine() {
+    if (onLine) {
+        onLine(std::count_if(stack.begin(), stack.end(), [](const Frame& frame) { return !frame.quote; }));
+    }
+    std::string line;
+    if (!std::getline(*stream, line)) {
+        return false;
+    }
+    buffer.erase(0, tokenizer.offset());
+    buffer += line;
+    buffer += '\n';
+    input = buffer;
+    tokenizer = Tokenizer(input, true);
+    return true;
+}
+
+std::optional<Token> Reader::nextToken() {
+    while (true) {
+        if (auto token = tokenizer.next()) {
+            return token;
+        }
+        if (stream == nullptr || !readLine()) {
+            if (tokenizer.offset() < input.size()) {
+                throw SyntaxError("Unexpected end of string literal");
+            }
+            return std::nullopt;
+        }
+    }
+}
+
+// After a syntax error, reading goes on from the next line.
+void Reader::recover() {
+    stack.clear();
+    tokenizer.skipLine();
+}
+
+std::optional<ValuePtr> Reader::read() {
+    try {
+        while (true) {
+            auto token = nextToken();
+            if (!token) {
+                if (stack.empty()) {
+                    return std::nullopt;
+                }
+                throw SyntaxError("Unexpected end of input.");
+            }
+
+            ValuePtr datum;
+            switch (token->getType()) {
+            case TokenType::LEFT_PAREN:
+                stack.emplace_back();
+                continue;
+
+            case TokenType::QUOTE:
+                stack.push_back({symbols::QUOTE});
+                continue;
+
+            case TokenType::QUASIQUOTE:
+                stack.push_back({symbols::QUASIQUOTE});
+                continue;
+
+            case TokenType::UNQUOTE:
+                stack.push_back({symbols::UNQUOTE});
+                continue;
+
+            case TokenType::DOT:
+                if (stack.empty() || stack.back().quote || stack.back().items.empty() || stack.back().dotted) {
+                    throw SyntaxError("Unexpected '.'.");
+                }
+                stack.back().dotted = true;
+                continue;
+
+            case TokenType::RIGHT_PAREN:
+            {
+                if (stack.empty() || stack.back().quote) {
+                    throw SyntaxError("Unexpected ')'.");
+                }
+                auto& frame = stack.back();
+                if (frame.dotted && !frame.tail) {
+                    throw SyntaxError("Expected a datum after '.'.");
+                }
+                datum = frame.dotted ? frame.tail : ValuePtr::nil();
+                for (auto item = frame.items.rbegin(); item != frame.items.rend(); ++item) {
+                    datum = makeValue<PairValue>(std::move(*item), std::move(datum));
+                }
+                stack.pop_back();
+                break;
+            }
+
+            case TokenType::BOOLEAN_LITERAL:
+                datum = ValuePtr::boolean(token->getBoolean());
+                break;
+
+            case TokenType::NUMERIC_LITERAL:
+                datum = numbers::fromLiteral(token->getName(), token->getNumber());
+                break;
+
+            case TokenType::STRING_LITERAL:
+                datum = makeValue<StringValue>(token->getString());
+                break;
+
+            case TokenType::IDENTIFIER:
+                datum = SymbolValue::intern(token->getName());
+                break;
+            }
+
+            // Wrap the datum in the quotes before it and hand it to the
+            // innermost open list, if any.
+            while (!stack.empty() && stack.back().quote) {
+                datum = makeValue<PairValue>(stack.back().quote->toValue(),
+                                             makeValue<PairValue>(std::move(datum), ValuePtr::nil()));
+                stack.pop_back();
+            }
+            if (stack.empty()) {
+                if (file != nullptr && tokenizer.offset() - released >= RELEASE_STEP) {
+                    file->release(released, tokenizer.offset());
+                    released = tokenizer.offset();
+                }
+                return datum;
+            }
+            auto& frame = stack.back();
+            if (!frame.dotted) {
+                frame.items.push_back(std::move(datum));
+            } else if (!frame.tail) {
+                frame.tail = std::move(datum);
+            } else {
+                throw SyntaxError("Expected ')'.");
+            }
+        }
+    } catch (SyntaxError&) {
+        recover();
+        throw;
+    }
+}
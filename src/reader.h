@@ -0,0 +1,54 @@
+#ifndef READER_H
+#define READER_H
+
+#include <functional>
+#include <istream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "./mapped_file.h"
+#include "./tokenizer.h"
+#include "./value.h"
+
+/**Reader class
+ * Reads one datum at a time from a buffer, or from a stream as far as the
+ * datum reaches, so the forms before it can run while the rest is unread.
+ * Values are built as their tokens arrive, with the enclosing lists and
+ * quotes kept on an explicit stack instead of the C++ one.
+ */
+class Reader {
+    struct Frame {
+        std::optional<Symbol> quote;    // (quote datum) to be wrapped, or else a list
+        std::vector<ValuePtr> items = {};
+        ValuePtr tail = nullptr;
+        bool dotted = false;
+    };
+
+    std::istream* stream = nullptr;
+    MappedFile* file = nullptr;
+    size_t released = 0;
+    std::string buffer;
+    std::string_view input;
+    Tokenizer tokenizer;
+    std::vector<Frame> stack;
+    std::function<void(size_t)> onLine;
+
+    std::optional<Token> nextToken();
+    bool readLine();
+    void recover();
+
+public:
+    Reader(std::string_view input);
+    // Pages of the file are released once the forms on them have been read.
+    Reader(MappedFile& file);
+    // onLine is called before each line is read from the stream, with the
+    // number of lists left open by the lines before.
+    Reader(std::istream& stream, std::function<void(size_t)> onLine = {});
+
+    // The next datum, or nothing at the end of the input.
+    std::optional<ValuePtr> read();
+};
+
+#endif
@@ -1128,6 +1128,242 @@ RMLT_CASE("(define (len s) (if (eq? s '()) 0 (+ 1 (len (cdr s)))))")
 RMLT_CASE("(len '(1 2 3 4))", "4")
 RMLT_END_CASES()
 
+RMLT_BEGIN_CASES(Eval)
+RMLT_CASE("(define z 1)")
+RMLT_CASE("(eval '(+ z 1))", "2")
+RMLT_CASE("(let ((z 7)) (eval (list '+ z 1)))", "8")
+RMLT_CASE("(eval '(define w 3))", "()")
+RMLT_CASE("w", "3")
+RMLT_END_CASES()
+
+// The tree-walker evaluates in the frame of the caller.
+RMLT_BEGIN_CASES(TreeEval)
+RMLT_CASE("(define z 1)")
+RMLT_CASE("(let ((z 7)) (eval 'z))", "7")
+RMLT_CASE("((lambda (z) (eval '(+ z 1))) 7)", "8")
+RMLT_CASE("((lambda (a) (let ((b 2)) (eval '(+ a b)))) 1)", "3")
+RMLT_CASE("(define (adder x) (eval '(lambda (y) (+ x y))))")
+RMLT_CASE("((adder 5) 1)", "6")
+RMLT_CASE("(define (redefine) (define a 1) (eval '(define a 2)) a)")
+RMLT_CASE("(redefine)", "2")
+RMLT_END_CASES()
+
+// Compiled code has no frame to show, so the VM evaluates at top level.
+RMLT_BEGIN_CASES(VmEval)
+RMLT_CASE("(define z 1)")
+RMLT_CASE("(let ((z 7)) (eval 'z))", "1")
+RMLT_CASE("((lambda (z) (eval '(+ z 1))) 7)", "2")
+RMLT_CASE("(define (f) (eval '(define w 3)))")
+RMLT_CASE("(f)", "()")
+RMLT_CASE("w", "3")
+RMLT_END_CASES()
+
+RMLT_BEGIN_CASES(Numbers)
+// Fixnums end at 2^47 - 1: results past either end are bignums, and
+// bignum results that fit again are fixnums. Bignums are compared as
+// strings, as the harness reads numbers as doubles.
+RMLT_CASE("(define max-fixnum 140737488355327)")
+RMLT_CASE("(number->string (+ max-fixnum 1))", "\"140737488355328\"")
+RMLT_CASE("(number->string (- (- max-fixnum) 2))", "\"-140737488355329\"")
+RMLT_CASE("(number->string (- (+ max-fixnum 1) 1))", "\"140737488355327\"")
+RMLT_CASE("(eq? (- (+ max-fixnum 1) 1) max-fixnum)", "#t")
+RMLT_CASE("(number->string (* max-fixnum max-fixnum))", "\"19807040628565802923409276929\"")
+RMLT_CASE("(number->string (expt 2 100))", "\"1267650600228229401496703205376\"")
+RMLT_CASE("(number->string (- (expt 2 100) (expt 2 100)))", "\"0\"")
+RMLT_CASE("(number->string (* (expt 10 20) (- (expt 10 20))))",
+          "\"-10000000000000000000000000000000000000000\"")
+RMLT_CASE("(= (expt 2 64) (* (expt 2 32) (expt 2 32)))", "#t")
+RMLT_CASE("(equal? (expt 2 64) 18446744073709551616)", "#t")
+RMLT_CASE("(< (expt 2 64) (+ (expt 2 64) 1))", "#t")
+// quotient truncates; remainder takes the sign of the dividend and modulo
+// that of the divisor.
+RMLT_CASE("(list (quotient 17 5) (quotient -17 5) (quotient 17 -5) (quotient -17 -5))",
+          "(3 -3 -3 3)")
+RMLT_CASE("(list (remainder 17 5) (remainder -17 5) (remainder 17 -5) (remainder -17 -5))",
+          "(2 -2 2 -2)")
+RMLT_CASE("(list (modulo 17 5) (modulo -17 5) (modulo 17 -5) (modulo -17 -5))", "(2 3 -3 -2)")
+RMLT_CASE("(number->string (quotient (- (expt 10 30)) (expt 10 15)))", "\"-1000000000000000\"")
+RMLT_CASE("(remainder (- (+ (expt 10 20) 7)) 10)", "-7")
+RMLT_CASE("(modulo (- (+ (expt 10 20) 7)) 10)", "3")
+RMLT_CASE("(modulo (expt 10 20) -3)", "-2")
+// Division of exact integers is exact if it leaves no remainder; an
+// inexact operand makes any result inexact.
+RMLT_CASE("(number->string (/ 6 3))", "\"2\"")
+RMLT_CASE("(number->string (/ 7 2))", "\"3.5\"")
+RMLT_CASE("(number->string (/ 6.0 3))", "\"2.0\"")
+RMLT_CASE("(number->string (/ (expt 2 64) (expt 2 32)))", "\"4294967296\"")
+RMLT_CASE("(integer? (/ 7 2))", "#f")
+RMLT_CASE("(number->string (* 1.5 2))", "\"3.0\"")
+RMLT_CASE("(number->string (+ max-fixnum 1.0))", "\"140737488355328.0\"")
+// Flonums are written in fixed notation from 1e-7 up to 1e21, and in
+// scientific notation outside that range.
+RMLT_CASE("(number->string 100000.0)", "\"100000.0\"")
+RMLT_CASE("(number->string 1000000.0)", "\"1000000.0\"")
+RMLT_CASE("(number->string 0.0001)", "\"0.0001\"")
+RMLT_CASE("(number->string -0.1)", "\"-0.1\"")
+RMLT_CASE("(number->string 0.0)", "\"0.0\"")
+RMLT_CASE("(number->string 1e20)", "\"100000000000000000000.0\"")
+RMLT_CASE("(number->string 1e21)", "\"1e+21\"")
+RMLT_CASE("(number->string 1.5e-8)", "\"1.5e-08\"")
+RMLT_END_CASES()
+
+RMLT_BEGIN_CASES(Vectors)
+// Vectors are compared through vector->list, as the harness does not read
+// their printed form.
+RMLT_CASE("(vector->list (vector 1 'a \"b\"))", "(1 a \"b\")")
+RMLT_CASE("(vector->list (make-vector 3 'x))", "(x x x)")
+RMLT_CASE("(vector->list (make-vector 2))", "(0 0)")
+RMLT_CASE("(vector->list (vector))", "()")
+RMLT_CASE("(vector-length (make-vector 5 0))", "5")
+RMLT_CASE("(define v (vector 1 2 3))")
+RMLT_CASE("(vector-ref v 0)", "1")
+RMLT_CASE("(vector-set! v 0 'one)", "()")
+RMLT_CASE("(vector->list v)", "(one 2 3)")
+RMLT_CASE("(vector-fill! v 7)", "()")
+RMLT_CASE("(vector->list v)", "(7 7 7)")
+RMLT_CASE("(vector->list (list->vector '(1 (2 3) 4)))", "(1 (2 3) 4)")
+RMLT_CASE("(vector->list (vector-map (lambda (x) (* x x)) (vector 1 2 3)))", "(1 4 9)")
+RMLT_CASE("(vector? v)", "#t")
+RMLT_CASE("(vector? '(7 7 7))", "#f")
+RMLT_CASE("(equal? (vector 1 (vector 2)) (vector 1 (vector 2)))", "#t")
+RMLT_CASE("(eq? (vector 1) (vector 1))", "#f")
+RMLT_CASE("(eq? v v)", "#t")
+// A vector may hold itself and procedures.
+RMLT_CASE("(vector-set! v 1 v)")
+RMLT_CASE("(eq? (vector-ref v 1) v)", "#t")
+RMLT_CASE("(vector-set! v 2 (lambda (x) (+ x 1)))")
+RMLT_CASE("((vector-ref (vector-ref v 1) 2) 41)", "42")
+RMLT_CASE("(define big (make-vector 100000 0))")
+RMLT_CASE("(vector-set! big 99999 'last)")
+RMLT_CASE("(list (vector-ref big 0) (vector-ref big 99999) (vector-length big))",
+          "(0 last 100000)")
+RMLT_END_CASES()
+
+RMLT_BEGIN_CASES(HashTables)
+// An equal? table compares keys by structure, bignums by value.
+RMLT_CASE("(define h (make-hash-table 'equal?))")
+RMLT_CASE("(hash-set! h '(1 2) 'list)")
+RMLT_CASE("(hash-set! h \"key\" 'string)")
+RMLT_CASE("(hash-set! h (expt 2 64) 'big)")
+RMLT_CASE("(hash-set! h 1.5 'flonum)")
+RMLT_CASE("(hash-ref h (list 1 2))", "list")
+RMLT_CASE("(hash-ref h (string-append \"k\" \"ey\"))", "string")
+RMLT_CASE("(hash-ref h (* (expt 2 32) (expt 2 32)))", "big")
+RMLT_CASE("(hash-ref h 1.5)", "flonum")
+RMLT_CASE("(hash-ref h 'missing 'none)", "none")
+RMLT_CASE("(hash-set! h (list 1 2) 'replaced)")
+RMLT_CASE("(list (hash-ref h '(1 2)) (hash-count h))", "(replaced 4)")
+RMLT_CASE("(hash-remove! h \"key\")")
+RMLT_CASE("(list (hash-ref h \"key\" #f) (hash-count h) (length (hash-keys h)))", "(#f 3 3)")
+// An eq? table compares numbers by value and everything else by identity.
+RMLT_CASE("(define e (make-hash-table 'eq?))")
+RMLT_CASE("(define k (list 1 2))")
+RMLT_CASE("(hash-set! e k 'k)")
+RMLT_CASE("(hash-ref e k)", "k")
+RMLT_CASE("(hash-ref e (list 1 2) 'other)", "other")
+RMLT_CASE("(hash-set! e \"s\" 1)")
+RMLT_CASE("(hash-ref e \"s\" 'other)", "other")
+RMLT_CASE("(hash-set! e 'sym 3)")
+RMLT_CASE("(hash-ref e 'sym)", "3")
+RMLT_CASE("(hash-set! e (expt 2 64) 'big)")
+RMLT_CASE("(hash-ref e (expt 2 64) 'none)", "big")
+RMLT_CASE("(hash-set! e 140737488355327 'fixnum)")
+RMLT_CASE("(hash-ref e (- (+ 140737488355327 1) 1))", "fixnum")
+RMLT_CASE("(hash-set! e 'self e)")
+RMLT_CASE("(eq? (hash-ref e 'self) e)", "#t")
+// Growing, and removing entries from the middle of probe sequences.
+RMLT_CASE("(define g (make-hash-table))")
+RMLT_CASE("(define (fill i) (if (< i 1000) (begin (hash-set! g (* i (expt 2 50)) i) (fill (+ i 1)))))")
+RMLT_CASE("(fill 0)")
+RMLT_CASE("(list (hash-count g) (hash-ref g (* 999 (expt 2 50))))", "(1000 999)")
+RMLT_CASE("(define (drop i) (if (< i 1000) (begin (hash-remove! g (* i (expt 2 50))) (drop (+ i 2)))))")
+RMLT_CASE("(drop 0)")
+RMLT_CASE("(list (hash-count g) (hash-ref g (* 999 (expt 2 50))) (hash-ref g (* 998 (expt 2 50)) 'gone))",
+          "(500 999 gone)")
+RMLT_CASE("(define total (vector 0))")
+RMLT_CASE("(hash-for-each g (lambda (key value) (vector-set! total 0 (+ (vector-ref total 0) value))))")
+RMLT_CASE("(vector-ref total 0)", "250000")
+RMLT_END_CASES()
+
+RMLT_BEGIN_CASES(Fasl)
+// run-cached answers whether the forms came from the cache, and the value
+// of the script.
+RMLT_CASE("(define script (scratch \"fasl.scm\"))")
+RMLT_CASE("(write-script script '((define (f x) (* x 10)) (f 1)))")
+RMLT_CASE("(run-cached script)", "(#f . 10)")
+RMLT_CASE("(run-cached script)", "(#t . 10)")
+// An edit that keeps the size of the script changes only its hash.
+RMLT_CASE("(write-script script '((define (f x) (* x 20)) (f 1)))")
+RMLT_CASE("(run-cached script)", "(#f . 20)")
+RMLT_CASE("(run-cached script)", "(#t . 20)")
+RMLT_CASE("(write-script script '((define (f x) (* x 300)) (f 1)))")
+RMLT_CASE("(run-cached script)", "(#f . 300)")
+RMLT_CASE("(run-cached script)", "(#t . 300)")
+// Each script has its own cache.
+RMLT_CASE("(define other (scratch \"other.scm\"))")
+RMLT_CASE("(write-script other '((define (f x) (* x 300)) (f 2)))")
+RMLT_CASE("(run-cached other)", "(#f . 600)")
+RMLT_CASE("(run-cached script)", "(#t . 300)")
+// Data of every kind come back from the cache as they were read.
+RMLT_CASE("(write-script script '('(a \"s\" 1.5 -7 #t #f () (b . c) (d (e)))))")
+RMLT_CASE("(run-cached script)", "(#f a \"s\" 1.5 -7 #t #f () (b . c) (d (e)))")
+RMLT_CASE("(run-cached script)", "(#t a \"s\" 1.5 -7 #t #f () (b . c) (d (e)))")
+RMLT_CASE("(write-script script '((number->string 18446744073709551616)))")
+RMLT_CASE("(run-cached script)", "(#f . \"18446744073709551616\")")
+RMLT_CASE("(run-cached script)", "(#t . \"18446744073709551616\")")
+// Literals nested deeper than the native stack, written as text as the
+// printer recurses.
+RMLT_CASE(
+    "(define (repeat s n) (if (= n 0) \"\" "
+    "(let ((half (repeat s (quotient n 2)))) (string-append half half (if (odd? n) s \"\")))))")
+RMLT_CASE(
+    "(write-script script (list (string-append \"(define deep '\" (repeat \"(\" 100000) \"leaf\" "
+    "(repeat \")\" 100000) \")\") '(define (depth x n) (if (pair? x) (depth (car x) (+ n 1)) (cons n x))) "
+    "'(depth deep 0)))")
+RMLT_CASE("(run-cached script)", "(#f 100000 . leaf)")
+RMLT_CASE("(run-cached script)", "(#t 100000 . leaf)")
+RMLT_END_CASES()
+
+RMLT_BEGIN_CASES(Image)
+// The image is saved by a script, as the test procedures of this context
+// are not builtins and cannot be saved.
+RMLT_CASE("(define image (scratch \"round-trip.img\"))")
+RMLT_CASE(
+    "(define forms '((define v (make-vector 2 0)) (vector-set! v 0 v) (vector-set! v 1 'end) "
+    "(define h (make-hash-table 'equal?)) (hash-set! h 'self h) (hash-set! h (expt 2 64) 'big) "
+    "(hash-set! h (vector 1 2) 'vec) (hash-set! h (list 'a (vector 3)) 'nested) "
+    "(define big (expt 2 100)) (define shared (list 1 2 3)) (define both (cons shared shared)) "
+    "(define (make-adder k) (lambda (x) (+ x k))) (define add5 (make-adder 5)) "
+    "(define (even2? n) (if (= n 0) #t (odd2? (- n 1)))) "
+    "(define (odd2? n) (if (= n 0) #f (even2? (- n 1)))) "
+    "(define (make-knot) (define cell (make-vector 1 0)) (define (get) cell) "
+    "(vector-set! cell 0 get) get) (define knot (make-knot)) "
+    "(define (make-counter) (define count (vector 0)) "
+    "(lambda () (vector-set! count 0 (+ (vector-ref count 0) 1)) (vector-ref count 0))) "
+    "(define counter (make-counter)) (counter)))")
+RMLT_CASE("(write-script (scratch \"image.scm\") (append forms (list (list 'save-image image))))")
+RMLT_CASE("(run-cached (scratch \"image.scm\"))", "(#f)")
+// Cycles through vectors, hash tables and closures come back whole.
+RMLT_CASE("(in-image image '(eq? (vector-ref v 0) v))", "#t")
+RMLT_CASE("(in-image image '(vector-ref v 1))", "end")
+RMLT_CASE("(in-image image '(eq? (hash-ref h 'self) h))", "#t")
+RMLT_CASE("(in-image image '(hash-ref h (* (expt 2 32) (expt 2 32))))", "big")
+// Keys holding vectors are hashed once the vectors are filled.
+RMLT_CASE("(in-image image '(list (hash-ref h (vector 1 2)) (hash-ref h (list 'a (vector 3)))))", "(vec nested)")
+RMLT_CASE("(in-image image '(eq? ((vector-ref (knot) 0)) (knot)))", "#t")
+RMLT_CASE("(in-image image '(eq? (car both) (cdr both)))", "#t")
+RMLT_CASE("(in-image image '(number->string big))", "\"1267650600228229401496703205376\"")
+// Procedures keep their captures and state, and can be called.
+RMLT_CASE("(in-image image '(add5 10))", "15")
+RMLT_CASE("(in-image image '((make-adder 1) 2))", "3")
+RMLT_CASE("(in-image image '(list (even2? 10) (odd2? 7)))", "(#t #t)")
+RMLT_CASE("(in-image image '(list (counter) (counter)))", "(2 3)")
+// An environment started from an image saves the same definitions.
+RMLT_CASE("(in-image image (list 'save-image (scratch \"again.img\")))", "()")
+RMLT_CASE("(in-image (scratch \"again.img\") '(list (add5 1) (counter) (eq? (vector-ref v 0) v)))",
+          "(6 2 #t)")
+RMLT_END_CASES()
+
 #undef RMLT_BEGIN_CASES
 #undef RMLT_CASE
 #undef RMLT_END_CASES
@@ -0,0 +1,77 @@
+#ifndef SCOPE_H
+#define SCOPE_H
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "./value.h"
+
+class Scope;
+using ScopePtr = std::shared_ptr<const Scope>;
+
+/**Scope class
+ * The names bound by one lambda call or let, in slot order: first the
+ * parameters, then the names of the internal defines in its body. Every
+ * frame created for it stores its values at the same slots, so analysis
+ * can resolve each local reference to a (depth, slot) pair. A null scope
+ * is the global frame, which is still keyed by name.
+ *
+ * A lambda scope has no parent. The variables its body takes from the
+ * scopes around it are its captures instead, copied into every closure
+ * made from it. Slots that a define assigns and a nested lambda captures
+ * hold a BoxValue, so closures made before the define still see it.
+ */
+class Scope {
+public:
+    struct Capture {
+        Symbol name;
+        bool boxed;
+    };
+
+    std::vector<Symbol> names;
+    size_t numParams;
+    ScopePtr parent;
+    std::vector<size_t> boxes;
+    std::vector<Capture> captures;
+
+    Scope(const std::vector<Symbol>& names, size_t numParams, ScopePtr parent,
+          std::vector<size_t> boxes = {}, std::vector<Capture> captures = {}) :
+        names{names}, numParams{numParams}, parent{parent},
+        boxes{std::move(boxes)}, captures{std::move(captures)} {}
+
+    std::optional<size_t> find(Symbol name) const {
+        for (size_t i = names.size(); i > 0; i--) {
+            if (names[i - 1] == name) {
+                return i - 1;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::optional<size_t> findCapture(Symbol name) const {
+        for (size_t i = 0; i < captures.size(); i++) {
+            if (captures[i].name == name) {
+                return i;
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool isBoxed(size_t slot) const {
+        return std::ranges::find(boxes, slot) != boxes.end();
+    }
+};
+
+// A variable of an enclosing scope, as seen from a frame: slot `index` of
+// the frame `depth` frames up, or capture `index` of the closure that
+// frame was called for.
+struct LocalBinding {
+    bool captured;
+    size_t depth;
+    size_t index;
+    bool boxed;
+};
+
+#endif
@@ -1,10 +1,9 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
-#include <memory>
-#include <optional>
 #include <ostream>
 #include <string>
+#include <string_view>
 
 enum class TokenType {
     LEFT_PAREN,
@@ -19,80 +18,41 @@ enum class TokenType {
     IDENTIFIER,
 };
 
-class Token;
-using TokenPtr = std::unique_ptr<Token>;
-
+/**Token class
+ * A plain value that refers back into the source it was read from: the
+ * text of an identifier, or the body of a string literal between its
+ * quotes with escapes left in. The source must outlive its tokens.
+ */
 class Token {
-private:
     TokenType type;
-
-protected:
-    Token(TokenType type) : type{type} {}
+    std::string_view text;
+    double number = 0;
 
 public:
-    virtual ~Token() = default;
+    Token(TokenType type, std::string_view text = {}) : type{type}, text{text} {}
 
-    static TokenPtr fromChar(char c);
-    static TokenPtr dot();
+    static Token numeric(std::string_view text, double value) {
+        Token token(TokenType::NUMERIC_LITERAL, text);
+        token.number = value;
+        return token;
+    }
 
     TokenType getType() const {
         return type;
     }
-    virtual std::string toString() const;
-};
-
-class BooleanLiteralToken : public Token {
-private:
-    bool value;
-
-public:
-    BooleanLiteralToken(bool value) : Token(TokenType::BOOLEAN_LITERAL), value{value} {}
-
-    static std::unique_ptr<BooleanLiteralToken> fromChar(char c);
-
-    bool getValue() const {
-        return value;
+    bool getBoolean() const {
+        return text == "#t";
     }
-    std::string toString() const override;
-};
-
-class NumericLiteralToken : public Token {
-private:
-    double value;
-
-public:
-    NumericLiteralToken(double value) : Token(TokenType::NUMERIC_LITERAL), value{value} {}
-
-    double getValue() const {
-        return value;
+    double getNumber() const {
+        return number;
     }
-    std::string toString() const override;
-};
-
-class StringLiteralToken : public Token {
-private:
-    std::string value;
-
-public:
-    StringLiteralToken(const std::string& value) : Token(TokenType::STRING_LITERAL), value{value} {}
-
-    const std::string& getValue() const {
-        return value;
+    std::string_view getName() const {
+        return text;
     }
-    std::string toString() const override;
-};
-
-class IdentifierToken : public Token {
-private:
-    std::string name;
+    // Body of a string literal with its escapes resolved.
+    std::string getString() const;
 
-public:
-    IdentifierToken(const std::string& name) : Token(TokenType::IDENTIFIER), name{name} {}
-
-    const std::string& getName() const {
-        return name;
-    }
-    std::string toString() const override;
+    std::string toString() const;
 };
 
 std::ostream& operator<<(std::ostream& os, const Token& token);
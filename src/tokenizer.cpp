@@ -1,91 +1,108 @@
 #include "./tokenizer.h"
 
 #include <cctype>
-#include <set>
-#include <stdexcept>
+#include <charconv>
 
 #include "./error.h"
 
-const std::set<char> TOKEN_END{'(', ')', '\'', '`', ',', '"'};
+namespace {
 
-TokenPtr Tokenizer::nextToken(int& pos) {
+bool isSpace(char c) {
+    return std::isspace(static_cast<unsigned char>(c));
+}
+
+bool isTokenEnd(char c) {
+    switch (c) {
+        case '(': case ')': case '\'': case '`': case ',': case '"': return true;
+        default: return isSpace(c);
+    }
+}
+
+// The whole text as a number, if it is one.
+std::optional<double> parseNumber(std::string_view text) {
+    const char* first = text.data();
+    const char* last = first + text.size();
+    if (*first == '+') {    // from_chars takes no explicit plus sign
+        first++;
+        if (first == last || *first == '-') {
+            return std::nullopt;
+        }
+    }
+    double value;
+    auto [end, error] = std::from_chars(first, last, value);
+    if (error != std::errc() || end != last) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+}
+
+std::optional<Token> Tokenizer::next() {
     while (pos < input.size()) {
         auto c = input[pos];
         if (c == ';') {
             while (pos < input.size() && input[pos] != '\n') {
                 pos++;
             }
-        } else if (std::isspace(c)) {
+        } else if (isSpace(c)) {
             pos++;
-        } else if (auto token = Token::fromChar(c)) {
+        } else if (c == '(') {
             pos++;
-            return token;
+            return Token(TokenType::LEFT_PAREN);
+        } else if (c == ')') {
+            pos++;
+            return Token(TokenType::RIGHT_PAREN);
+        } else if (c == '\'') {
+            pos++;
+            return Token(TokenType::QUOTE);
+        } else if (c == '`') {
+            pos++;
+            return Token(TokenType::QUASIQUOTE);
+        } else if (c == ',') {
+            pos++;
+            return Token(TokenType::UNQUOTE);
         } else if (c == '#') {
-            if (auto result = BooleanLiteralToken::fromChar(input[pos + 1])) {
+            if (pos + 1 < input.size() && (input[pos + 1] == 't' || input[pos + 1] == 'f')) {
                 pos += 2;
-                return result;
+                return Token(TokenType::BOOLEAN_LITERAL, input.substr(pos - 2, 2));
             } else {
                 throw SyntaxError("Unexpected character after #");
             }
         } else if (c == '"') {
-            std::string string;
-            pos++;
+            size_t start = ++pos;
             while (pos < input.size()) {
                 if (input[pos] == '"') {
                     pos++;
-                    return std::make_unique<StringLiteralToken>(string);
+                    return Token(TokenType::STRING_LITERAL, input.substr(start, pos - 1 - start));
                 } else if (input[pos] == '\\') {
-                    if (pos + 1 >= input.size()) {
-                        throw SyntaxError("Unexpected end of string literal");
-                    }
-                    auto next = input[pos + 1];
-                    if (next == 'n') {
-                        string += '\n';
-                    } else {
-                        string += next;
-                    }
                     pos += 2;
                 } else {
-                    string += input[pos];
                     pos++;
                 }
             }
+            if (partial) {
+                pos = start - 1;
+                return std::nullopt;
+            }
             throw SyntaxError("Unexpected end of string literal");
         } else {
-            int start = pos;
+            size_t start = pos;
             do {
                 pos++;
-            } while (pos < input.size() && !std::isspace(input[pos]) &&
-                     !TOKEN_END.contains(input[pos]));
+            } while (pos < input.size() && !isTokenEnd(input[pos]));
             auto text = input.substr(start, pos - start);
             if (text == ".") {
-                return Token::dot();
+                return Token(TokenType::DOT);
             }
-            if (std::isdigit(text[0]) || text[0] == '+' || text[0] == '-' || text[0] == '.') {
-                try {
-                    return std::make_unique<NumericLiteralToken>(std::stod(text));
-                } catch (std::invalid_argument& e) {
+            if (std::isdigit(static_cast<unsigned char>(text[0])) || text[0] == '+' || text[0] == '-' ||
+                text[0] == '.') {
+                if (auto number = parseNumber(text)) {
+                    return Token::numeric(text, *number);
                 }
             }
-            return std::make_unique<IdentifierToken>(text);
+            return Token(TokenType::IDENTIFIER, text);
         }
     }
-    return nullptr;
-}
-
-std::deque<TokenPtr> Tokenizer::tokenize() {
-    std::deque<TokenPtr> tokens;
-    int pos = 0;
-    while (true) {
-        auto token = nextToken(pos);
-        if (!token) {
-            break;
-        }
-        tokens.push_back(std::move(token));
-    }
-    return tokens;
-}
-
-std::deque<TokenPtr> Tokenizer::tokenize(const std::string& input) {
-    return Tokenizer(input).tokenize();
+    return std::nullopt;
 }
@@ -1,21 +1,37 @@
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
 
-#include <deque>
-#include <string>
+#include <optional>
+#include <string_view>
 
 #include "./token.h"
 
+/**Tokenizer class
+ * Scans a view of the source without copying it; tokens point into that
+ * source, which has to stay alive while they are used. A partial input is
+ * the part of a stream read so far: a string literal it ends in is left
+ * unread, to be scanned again once more of the stream has arrived.
+ */
 class Tokenizer {
-private:
-    TokenPtr nextToken(int& pos);
-    std::deque<TokenPtr> tokenize();
-
-    std::string input;
-    Tokenizer(const std::string& input) : input{input} {}
+    std::string_view input;
+    size_t pos = 0;
+    bool partial;
 
 public:
-    static std::deque<TokenPtr> tokenize(const std::string& input);
+    Tokenizer(std::string_view input, bool partial = false) : input{input}, partial{partial} {}
+
+    // The next token, or nothing at the end of the input.
+    std::optional<Token> next();
+
+    // Where the input was left off.
+    size_t offset() const {
+        return pos;
+    }
+
+    // Drops the rest of the current line.
+    void skipLine() {
+        while (pos < input.size() && input[pos++] != '\n') {}
+    }
 };
 
-#endif
\ No newline at end of file
+#endif
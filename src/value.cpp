@@ -1,76 +1,137 @@
-#include <cmath>
+#include <cctype>
 #include <iomanip>
 #include <sstream>
+#include <unordered_map>
+#include <utility>
 
 #include "./error.h"
 #include "./eval_env.h"
+#include "./node.h"
+#include "./number.h"
 #include "./value.h"
 
-/**Value class
- * Methods for base class Value 
+/**Symbol class
+ * Methods for interned symbol handles
  */
-ValueType Value::getType() const {
-    return type;
+struct Symbol::Entry {
+    std::string name;
+    ValuePtr value;
+};
+
+Symbol Symbol::intern(std::string_view name) {
+    // Constructed on first use, since symbols are interned during static
+    // initialization of other translation units.
+    static std::unordered_map<std::string_view, std::unique_ptr<Entry>> table;
+    if (auto entry = table.find(name); entry != table.end()) {
+        return Symbol(entry->second.get());
+    }
+    auto entry = std::make_unique<Entry>(std::string(name), nullptr);
+    Symbol symbol(entry.get());
+    entry->value = makeValue<SymbolValue>(symbol);
+    table.emplace(entry->name, std::move(entry));
+    return symbol;
 }
 
-std::string Value::toString() const {
-    return "";
+const std::string& Symbol::name() const {
+    return entry->name;
 }
 
-std::vector<ValuePtr> Value::toVector() const {
-    throw LispError("Cannot convert to vector");
+ValuePtr Symbol::toValue() const {
+    return entry->value;
 }
 
-bool Value::isType(ValueType type) const {
-    return this->type == type;
+namespace symbols {
+const Symbol QUOTE = Symbol::intern("quote");
+const Symbol QUASIQUOTE = Symbol::intern("quasiquote");
+const Symbol UNQUOTE = Symbol::intern("unquote");
+const Symbol UNQUOTE_COMMA = Symbol::intern(",");
+const Symbol LAMBDA = Symbol::intern("lambda");
+const Symbol LET = Symbol::intern("let");
+const Symbol DEFINE = Symbol::intern("define");
+const Symbol ELSE = Symbol::intern("else");
 }
 
-bool Value::asBoolean() const {
-    return true;
+
+/**ValuePtr class
+ * Methods of the value handle that depend on the kind of value
+ */
+std::string ValuePtr::toString() const {
+    if (isFlonum()) {
+        return numbers::flonumToString(std::bit_cast<double>(bits));
+    } else if (isFixnum()) {
+        return std::to_string(getFixnum());
+    } else if (bits == NIL_BITS) {
+        return "()";
+    } else if (bits == TRUE_BITS || bits == FALSE_BITS) {
+        return asBoolean() ? "#t" : "#f";
+    }
+    return get()->toString();
 }
 
-std::optional<double> Value::asNumber() const {
-    return std::nullopt;
+std::vector<ValuePtr> ValuePtr::toVector() const {
+    if (bits == NIL_BITS) {
+        return {};
+    } else if (Value* value = get()) {
+        return value->toVector();
+    }
+    throw LispError("Cannot convert to vector");
 }
 
-std::optional<std::string> Value::asString() const {
+std::optional<std::string> ValuePtr::asString() const {
+    if (Value* value = get()) {
+        return value->asString();
+    }
     return std::nullopt;
 }
 
-std::optional<std::string> Value::asSymbol() const {
+std::optional<Symbol> ValuePtr::asSymbol() const {
+    if (Value* value = get()) {
+        return value->asSymbol();
+    }
     return std::nullopt;
 }
 
-ValuePtr Value::call(const std::vector<ValuePtr>& args, EvalEnv& env) const {
+ValuePtr ValuePtr::call(Arguments args, EvalEnv& env) const {
+    if (Value* value = get()) {
+        return value->call(args, env);
+    }
     throw LispError("Cannot call this value");
 }
 
 
-/**BooleanValue class
- * Methods for derived class BooleanValue 
+/**Value class
+ * Methods for base class Value 
  */
-std::string BooleanValue::toString() const {
-    return value ? "#t" : "#f";
+ValueType Value::getType() const {
+    return type;
 }
 
-bool BooleanValue::asBoolean() const {
-    return value;
+std::string Value::toString() const {
+    return "";
+}
+
+std::vector<ValuePtr> Value::toVector() const {
+    throw LispError("Cannot convert to vector");
 }
 
+bool Value::isType(ValueType type) const {
+    return this->type == type;
+}
 
-/**NumericValue class
- * Methods for derived class NumericValue 
- */
-std::string NumericValue::toString() const {
-    if (std::floor(value) == value) {
-        return std::to_string(static_cast<int>(value));
-    } else {
-        return std::to_string(value);
-    }
+std::optional<double> Value::asNumber() const {
+    return std::nullopt;
 }
 
-std::optional<double> NumericValue::asNumber() const {
-    return value;
+std::optional<std::string> Value::asString() const {
+    return std::nullopt;
+}
+
+std::optional<Symbol> Value::asSymbol() const {
+    return std::nullopt;
+}
+
+ValuePtr Value::call(Arguments args, EvalEnv& env) const {
+    throw LispError("Cannot call this value");
 }
 
 
@@ -88,26 +149,18 @@ std::optional<std::string> StringValue::asString() const {
 }
 
 
-/**NilValue class
- * Methods for derived class NilValue
- */
-std::string NilValue::toString() const {
-    return "()";
-}
-
-std::vector<ValuePtr> NilValue::toVector() const {
-    return {};
-}
-
-
 /**SymbolValue class
  * Methods for derived class SymbolValue
  */
+ValuePtr SymbolValue::intern(std::string_view name) {
+    return Symbol::intern(name).toValue();
+}
+
 std::string SymbolValue::toString() const {
-    return value;
+    return value.name();
 }
 
-std::optional<std::string> SymbolValue::asSymbol() const {
+std::optional<Symbol> SymbolValue::asSymbol() const {
     return value;
 }
 
@@ -115,16 +168,28 @@ std::optional<std::string> SymbolValue::asSymbol() const {
 /**PairValue class
  * Methods for derived class PairValue
  */
-PairValue::PairValue(const std::vector<ValuePtr>& values) : Value(ValueType::PAIR) {
-    if (values.empty()) {
-        throw SyntaxError("Cannot create a pair from empty list");
+// Freeing the cdr would free the next pair from inside this destructor,
+// and so on down the list; freeing the car, the same down a nested one.
+// Instead the pairs only this one holds are detached and handed to the
+// outermost destructor, which frees them one at a time, however long or
+// deep the list.
+PairValue::~PairValue() {
+    static std::vector<ValuePtr> pending;
+    static bool draining = false;
+    for (auto child : {&car, &cdr}) {
+        if (*child && (*child)->isType(ValueType::PAIR) && child->get()->refCount() == 1) {
+            pending.push_back(std::move(*child));
+        }
     }
-    car = values[0];
-    if (values.size() == 1) {
-        cdr = std::make_shared<NilValue>();
-    } else {
-        cdr = std::make_shared<PairValue>(std::vector<ValuePtr>(values.begin() + 1, values.end()));
+    if (draining) {
+        return;
     }
+    draining = true;
+    while (!pending.empty()) {
+        ValuePtr next = std::move(pending.back());
+        pending.pop_back();
+    }
+    draining = false;
 }
 
 std::string PairValue::toString() const {
@@ -166,20 +231,225 @@ std::vector<ValuePtr> PairValue::toVector() const {
     return result;
 }
 
-ValuePtr PairValue::getCar() const {
-    return car;
+void PairValue::trace(std::vector<Collectable*>& children) const {
+    traceValue(car, children);
+    traceValue(cdr, children);
 }
 
-ValuePtr PairValue::getCdr() const {
-    return cdr;
+void PairValue::clearReferences() {
+    car = nullptr;
+    cdr = nullptr;
+}
+
+
+/**ListBuilder class
+ * Methods for building lists
+ */
+void ListBuilder::push(ValuePtr value) {
+    auto pair = makeValue<PairValue>(std::move(value), ValuePtr::nil());
+    auto next = static_cast<PairValue*>(pair.get());
+    if (last == nullptr) {
+        head = std::move(pair);
+    } else {
+        last->cdr = std::move(pair);
+    }
+    last = next;
+}
+
+ValuePtr ListBuilder::finish(ValuePtr tail) {
+    if (last == nullptr) {
+        return tail;
+    }
+    last->cdr = std::move(tail);
+    last = nullptr;
+    return std::exchange(head, ValuePtr::nil());
+}
+
+ValuePtr makeList(Arguments values) {
+    ListBuilder result;
+    for (const auto& value : values) {
+        result.push(value);
+    }
+    return result.finish();
+}
+
+
+/**ListView class
+ * Methods for the view of a list
+ */
+size_t ListView::size() const {
+    size_t result = 0;
+    for (auto it = begin(); it != end(); ++it) {
+        result++;
+    }
+    return result;
+}
+
+const ValuePtr& ListView::tail() const {
+    auto it = begin();
+    while (it != end()) {
+        ++it;
+    }
+    return it.rest();
+}
+
+
+/**VectorValue class
+ * Methods for derived class VectorValue
+ */
+std::string VectorValue::toString() const {
+    std::stringstream ss;
+    ss << "#(";
+    for (size_t i = 0; i < elements.size(); i++) {
+        ss << (i == 0 ? "" : " ") << elements[i]->toString();
+    }
+    ss << ")";
+    return ss.str();
+}
+
+void VectorValue::trace(std::vector<Collectable*>& children) const {
+    for (const auto& element : elements) {
+        traceValue(element, children);
+    }
+}
+
+void VectorValue::clearReferences() {
+    elements.clear();
+}
+
+
+/**Equality
+ * Both walk nested pairs and vectors with an explicit stack, so long
+ * lists are compared and hashed without deep recursion.
+ */
+bool equalValues(const ValuePtr& left, const ValuePtr& right) {
+    std::vector<std::pair<const ValuePtr*, const ValuePtr*>> pending{{&left, &right}};
+    while (!pending.empty()) {
+        auto [a, b] = pending.back();
+        pending.pop_back();
+        if ((*a)->getType() != (*b)->getType()) {
+            return false;
+        }
+        switch ((*a)->getType()) {
+        case ValueType::NUMERIC:
+            if (!numbers::eqv(*a, *b)) {
+                return false;
+            }
+            break;
+        case ValueType::BOOLEAN:
+            if ((*a)->asBoolean() != (*b)->asBoolean()) {
+                return false;
+            }
+            break;
+        case ValueType::NIL:
+            break;
+        case ValueType::STRING:
+            if (static_cast<StringValue*>(a->get())->getValue() != static_cast<StringValue*>(b->get())->getValue()) {
+                return false;
+            }
+            break;
+        case ValueType::PAIR:
+        {
+            auto pairA = static_cast<PairValue*>(a->get());
+            auto pairB = static_cast<PairValue*>(b->get());
+            pending.push_back({&pairA->getCdr(), &pairB->getCdr()});
+            pending.push_back({&pairA->getCar(), &pairB->getCar()});
+            break;
+        }
+        case ValueType::VECTOR:
+        {
+            const auto& elementsA = static_cast<VectorValue*>(a->get())->getElements();
+            const auto& elementsB = static_cast<VectorValue*>(b->get())->getElements();
+            if (elementsA.size() != elementsB.size()) {
+                return false;
+            }
+            for (size_t i = elementsA.size(); i > 0; i--) {
+                pending.push_back({&elementsA[i - 1], &elementsB[i - 1]});
+            }
+            break;
+        }
+        default:
+            if (a->get() != b->get()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+namespace {
+
+size_t mix(size_t hash, size_t value) {
+    hash ^= value + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+}
+
+size_t hashValue(const ValuePtr& value) {
+    size_t hash = 0;
+    std::vector<const ValuePtr*> pending{&value};
+    while (!pending.empty()) {
+        const ValuePtr& current = *pending.back();
+        pending.pop_back();
+        auto type = current->getType();
+        hash = mix(hash, static_cast<size_t>(type));
+        switch (type) {
+        case ValueType::NUMERIC:
+            hash = mix(hash, numbers::hash(current));
+            break;
+        case ValueType::BOOLEAN:
+            hash = mix(hash, current->asBoolean());
+            break;
+        case ValueType::NIL:
+            break;
+        case ValueType::STRING:
+            hash = mix(hash, std::hash<std::string>{}(static_cast<StringValue*>(current.get())->getValue()));
+            break;
+        case ValueType::SYMBOL:
+            hash = mix(hash, std::hash<Symbol>{}(current->asSymbol().value()));
+            break;
+        case ValueType::PAIR:
+        {
+            auto pair = static_cast<PairValue*>(current.get());
+            pending.push_back(&pair->getCdr());
+            pending.push_back(&pair->getCar());
+            break;
+        }
+        case ValueType::VECTOR:
+        {
+            const auto& elements = static_cast<VectorValue*>(current.get())->getElements();
+            hash = mix(hash, elements.size());
+            for (size_t i = elements.size(); i > 0; i--) {
+                pending.push_back(&elements[i - 1]);
+            }
+            break;
+        }
+        default:
+            hash = mix(hash, std::hash<const void*>{}(current.get()));
+        }
+    }
+    return hash;
 }
 
 
 /**BuiltinProcValue class
  * Methods for derived class BuiltinProcValu
  */
-ValuePtr BuiltinProcValue::call(const std::vector<ValuePtr>& args, EvalEnv& env) const {
-    return func(args, env);
+ValuePtr BuiltinProcValue::call(Arguments args, EvalEnv& env) const {
+    if (fixed && args.size() == arity) {
+        return fixed(*this, args.data());
+    } else if (func) {
+        return func(args, env);
+    }
+    constexpr const char* COUNTS[] = {"no arguments", "one argument", "two arguments", "three arguments"};
+    fail(COUNTS[arity]);
+}
+
+void BuiltinProcValue::fail(std::string_view requirement) const {
+    std::string message(name);
+    message[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(message[0])));
+    throw LispError(message + " requires " + std::string(requirement) + ".");
 }
 
 std::string BuiltinProcValue::toString() const {
@@ -190,15 +460,40 @@ std::string BuiltinProcValue::toString() const {
 /**LambdaValue class
  * Methods for derived class LambdaValue 
  */
-ValuePtr LambdaValue::call(const std::vector<ValuePtr>& args, EvalEnv& env) const {
-    auto childEnv = this->env->createChild(params, args);
-    ValuePtr lastValue;
-    for (const auto& expr : body) {
-        lastValue = childEnv->eval(expr);
+// Lambdas called in tail position come back to this loop instead of
+// nesting another call, so tail recursion runs in constant space.
+// The frame takes the place of the arguments on the ValueStack, and a
+// tail call moves its arguments down to the same place.
+ValuePtr LambdaValue::call(Arguments args, EvalEnv& env) const {
+    size_t base = ValueStack::adopt(args);
+    ValueStack::Mark mark(base);
+    TailCall tail;
+    EvalEnv& global = env.globalFrame();
+    const LambdaValue* lambda = this;
+    ValuePtr running;   // keeps `lambda` alive
+    while (true) {
+        {
+            EvalEnv frame(global, lambda->code->getScope(), base, lambda->captures);
+            if (auto result = evalBody(lambda->code->getBody(), frame, tail)) {
+                return result;
+            }
+        }
+        running = std::move(tail.proc);
+        lambda = static_cast<const LambdaValue*>(running.get());
+        ValueStack::replace(base, tail.argc);
     }
-    return lastValue;
 }
 
 std::string LambdaValue::toString() const {
     return "#<procedure>";
+}
+
+void LambdaValue::trace(std::vector<Collectable*>& children) const {
+    for (const auto& value : captures) {
+        traceValue(value, children);
+    }
+}
+
+void LambdaValue::clearReferences() {
+    captures.clear();
 }
\ No newline at end of file
@@ -1,14 +1,64 @@
 #ifndef VALUE_H
 #define VALUE_H
 
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "./allocator.h"
+#include "./gc.h"
+
 class Value;
 class EvalEnv;
-using ValuePtr = std::shared_ptr<Value>;
+class LambdaTemplate;
+class ValuePtr;
+
+// The arguments of a procedure call, wherever the caller keeps them.
+using Arguments = std::span<const ValuePtr>;
+// The slots of a frame or the captures of a closure.
+using ValueVector = std::vector<ValuePtr, SlabAllocator<ValuePtr>>;
+
+/**Symbol class
+ * Handle of an interned name. Every distinct name is stored exactly once
+ * in a process-wide table, together with its only SymbolValue, so symbols
+ * compare and hash by address.
+ */
+class Symbol {
+    struct Entry;
+    const Entry* entry;
+
+    explicit Symbol(const Entry* entry) : entry{entry} {}
+
+    friend struct std::hash<Symbol>;
+
+public:
+    static Symbol intern(std::string_view name);
+
+    const std::string& name() const;
+    ValuePtr toValue() const;
+
+    bool operator==(const Symbol& other) const = default;
+};
+
+template <>
+struct std::hash<Symbol> {
+    size_t operator()(const Symbol& symbol) const {
+        return std::hash<const void*>{}(symbol.entry);
+    }
+};
+
+// Symbols the analyzer and compiler dispatch on.
+namespace symbols {
+extern const Symbol QUOTE, QUASIQUOTE, UNQUOTE, UNQUOTE_COMMA, LAMBDA, LET, DEFINE, ELSE;
+}
 
 enum class ValueType {
     BOOLEAN,
@@ -18,15 +68,156 @@ enum class ValueType {
     SYMBOL,
     PAIR,
     BUILTIN,
-    LAMBDA
+    LAMBDA,
+    VECTOR,
+    HASH_TABLE,
+    BOX     // internal mutable cell of frames, never seen by Lisp programs
+};
+
+/**ValuePtr class
+ * A handle to a Lisp value in one 64-bit word. Flonums, fixnums, booleans
+ * and nil are stored inline with NaN-boxing: every double outside the
+ * quiet NaNs tagged below is a flonum, and the tagged ones encode the
+ * other immediates and pointers to heap values. A fixnum is an exact
+ * integer of 48 bits, kept two's complement in the low bits. Heap values are reference
+ * counted without atomics, as the interpreter is single-threaded. The
+ * handle answers the queries of Value itself, so `value->asNumber()`
+ * reads the same for immediates and heap values. A default-constructed
+ * handle is empty and tests false.
+ */
+class ValuePtr {
+    static constexpr uint64_t SIGN = 0x8000000000000000;
+    static constexpr uint64_t QNAN = 0x7ffc000000000000;
+    static constexpr uint64_t POINTER = SIGN | QNAN;
+    static constexpr uint64_t NIL_BITS = QNAN | 1;
+    static constexpr uint64_t FALSE_BITS = QNAN | 2;
+    static constexpr uint64_t TRUE_BITS = QNAN | 3;
+    static constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+    static constexpr uint64_t FIXNUM = QNAN | 0x0002000000000000;
+    static constexpr uint64_t PAYLOAD = 0x0000ffffffffffff;
+
+    uint64_t bits;
+
+    static ValuePtr fromBits(uint64_t bits) {
+        ValuePtr result;
+        result.bits = bits;
+        return result;
+    }
+
+    void retain() const;
+    void release() const;
+
+public:
+    ValuePtr() : bits{POINTER} {}
+    ValuePtr(std::nullptr_t) : bits{POINTER} {}
+    explicit ValuePtr(Value* value) : bits{POINTER | reinterpret_cast<uintptr_t>(value)} { retain(); }
+
+    ValuePtr(const ValuePtr& other) : bits{other.bits} { retain(); }
+    ValuePtr(ValuePtr&& other) noexcept : bits{other.bits} { other.bits = POINTER; }
+    ValuePtr& operator=(const ValuePtr& other) {
+        other.retain();
+        release();
+        bits = other.bits;
+        return *this;
+    }
+    ValuePtr& operator=(ValuePtr&& other) noexcept {
+        if (this != &other) {
+            release();
+            bits = other.bits;
+            other.bits = POINTER;
+        }
+        return *this;
+    }
+    ~ValuePtr() { release(); }
+
+    static constexpr int64_t FIXNUM_MIN = -(int64_t{1} << 47);
+    static constexpr int64_t FIXNUM_MAX = (int64_t{1} << 47) - 1;
+
+    // An inexact number.
+    static ValuePtr number(double value) {
+        return fromBits(value != value ? CANONICAL_NAN : std::bit_cast<uint64_t>(value));
+    }
+    // An exact integer, which must lie between FIXNUM_MIN and FIXNUM_MAX.
+    static ValuePtr fixnum(int64_t value) {
+        return fromBits(FIXNUM | (static_cast<uint64_t>(value) & PAYLOAD));
+    }
+    // An exact integer of any size, see numbers::integer.
+    static ValuePtr integer(int64_t value);
+    static ValuePtr boolean(bool value) {
+        return fromBits(value ? TRUE_BITS : FALSE_BITS);
+    }
+    static ValuePtr nil() {
+        return fromBits(NIL_BITS);
+    }
+
+    // The heap value, or nullptr for immediates and empty handles.
+    Value* get() const {
+        return (bits & POINTER) == POINTER ? reinterpret_cast<Value*>(bits & ~POINTER) : nullptr;
+    }
+    const ValuePtr* operator->() const {
+        return this;
+    }
+    explicit operator bool() const {
+        return bits != POINTER;
+    }
+
+    ValueType getType() const;
+    bool isType(ValueType type) const {
+        return getType() == type;
+    }
+
+    bool isFlonum() const {
+        return (bits & QNAN) != QNAN;
+    }
+    bool isFixnum() const {
+        return (bits & (SIGN | FIXNUM)) == FIXNUM;
+    }
+    int64_t getFixnum() const {
+        return static_cast<int64_t>(bits << 16) >> 16;
+    }
+
+    std::string toString() const;
+    std::vector<ValuePtr> toVector() const;
+
+    bool asBoolean() const {
+        return bits != FALSE_BITS;
+    }
+    std::optional<double> asNumber() const;
+    std::optional<std::string> asString() const;
+    std::optional<Symbol> asSymbol() const;
+
+    ValuePtr call(Arguments args, EvalEnv& env) const;
+    ValuePtr call(std::initializer_list<ValuePtr> args, EvalEnv& env) const {
+        return call(Arguments(args.begin(), args.size()), env);
+    }
 };
 
-class Value {
+
+/**Value class
+ * Base of the values that live on the heap, see ValuePtr.
+ */
+class Value : public Collectable {
     ValueType type;
+    mutable uint32_t references = 0;
+
+    friend class ValuePtr;
 
 public:
     Value(ValueType type) : type{type} {}
 
+    size_t refCount() const override {
+        return references;
+    }
+
+    // Heap values live in the slab allocator; the virtual destructor makes
+    // delete pass the size of the most derived class.
+    static void* operator new(size_t size) {
+        return slabAllocate(size);
+    }
+    static void operator delete(void* pointer, size_t size) {
+        slabDeallocate(pointer, size);
+    }
+
     ValueType getType() const;
 
     virtual std::string toString() const;
@@ -34,114 +225,331 @@ public:
 
     bool isType(ValueType type) const;
 
-    virtual bool asBoolean() const;
     virtual std::optional<double> asNumber() const;
     virtual std::optional<std::string> asString() const;
-    virtual std::optional<std::string> asSymbol() const;
+    virtual std::optional<Symbol> asSymbol() const;
 
-    virtual ValuePtr call(const std::vector<ValuePtr>& args, EvalEnv& env) const;
+    virtual ValuePtr call(Arguments args, EvalEnv& env) const;
 };
 
+template <typename T, typename... Args>
+ValuePtr makeValue(Args&&... args) {
+    ValuePtr result(new T(std::forward<Args>(args)...));
+    Collector::maybeCollect();
+    return result;
+}
+
+inline void traceValue(const ValuePtr& value, std::vector<Collectable*>& children) {
+    if (Value* heap = value.get()) {
+        children.push_back(heap);
+    }
+}
+
+inline void ValuePtr::retain() const {
+    if (Value* value = get()) {
+        value->references++;
+    }
+}
+
+inline void ValuePtr::release() const {
+    if (Value* value = get(); value && --value->references == 0) {
+        delete value;
+    }
+}
+
+inline ValueType ValuePtr::getType() const {
+    if (isFlonum() || isFixnum()) {
+        return ValueType::NUMERIC;
+    } else if (bits == NIL_BITS) {
+        return ValueType::NIL;
+    } else if (bits == TRUE_BITS || bits == FALSE_BITS) {
+        return ValueType::BOOLEAN;
+    }
+    return get()->getType();
+}
+
+// The value of any number as a double, rounded if need be.
+inline std::optional<double> ValuePtr::asNumber() const {
+    if (isFlonum()) {
+        return std::bit_cast<double>(bits);
+    } else if (isFixnum()) {
+        return static_cast<double>(getFixnum());
+    } else if (Value* value = get()) {
+        return value->asNumber();
+    }
+    return std::nullopt;
+}
 
-class BooleanValue : public Value {
-    bool value;
+
+class StringValue : public Value {
+    std::string value;
 
 public:
-    BooleanValue(bool value) : Value(ValueType::BOOLEAN), value{value} {}
+    StringValue(const std::string& value) : Value(ValueType::STRING), value{value} {}
 
     std::string toString() const override;
 
-    bool asBoolean() const override;
+    std::optional<std::string> asString() const override;
+
+    const std::string& getValue() const {
+        return value;
+    }
 };
 
 
-class NumericValue : public Value {
-    double value;
+class SymbolValue : public Value {
+    Symbol value;
 
 public:
-    NumericValue(double value) : Value(ValueType::NUMERIC), value{value} {}
+    // Only the intern table creates symbol values; use intern instead.
+    SymbolValue(Symbol value) : Value(ValueType::SYMBOL), value{value} {}
+
+    static ValuePtr intern(std::string_view name);
 
     std::string toString() const override;
 
-    std::optional<double> asNumber() const override;
+    std::optional<Symbol> asSymbol() const override;
 };
 
-class StringValue : public Value {
-    std::string value;
+
+class PairValue : public Value {
+    ValuePtr car;
+    ValuePtr cdr;
+
+    friend class ListBuilder;
 
 public:
-    StringValue(const std::string& value) : Value(ValueType::STRING), value{value} {}
+    PairValue(ValuePtr car, ValuePtr cdr) : Value(ValueType::PAIR), car{std::move(car)}, cdr{std::move(cdr)} {}
+    ~PairValue();
 
     std::string toString() const override;
+    std::vector<ValuePtr> toVector() const override;
 
-    std::optional<std::string> asString() const override;
+    void trace(std::vector<Collectable*>& children) const override;
+    void clearReferences() override;
+
+    const ValuePtr& getCar() const {
+        return car;
+    }
+    const ValuePtr& getCdr() const {
+        return cdr;
+    }
 };
 
 
-class NilValue : public Value {
-public:
-    NilValue() : Value(ValueType::NIL) {}
+/**ListView class
+ * The elements of a list, walked in place through the cdrs: iterating
+ * neither copies the list nor touches reference counts. Whatever is left
+ * after the last pair is the tail, nil for a proper list, and an atom is
+ * an empty view with itself as the tail. The view refers into the list
+ * and must not outlive it.
+ */
+class ListView {
+    const ValuePtr* list;
 
-    std::string toString() const override;
-    std::vector<ValuePtr> toVector() const override;
+public:
+    class iterator {
+        const ValuePtr* current;
+
+    public:
+        using iterator_concept = std::input_iterator_tag;
+        using value_type = ValuePtr;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() : current{nullptr} {}
+        explicit iterator(const ValuePtr* current) : current{current} {}
+
+        const ValuePtr& operator*() const {
+            return static_cast<const PairValue*>(current->get())->getCar();
+        }
+        iterator& operator++() {
+            current = &static_cast<const PairValue*>(current->get())->getCdr();
+            return *this;
+        }
+        iterator operator++(int) {
+            auto result = *this;
+            ++*this;
+            return result;
+        }
+        bool operator==(std::default_sentinel_t) const {
+            return !(*current)->isType(ValueType::PAIR);
+        }
+        // Whatever follows the current pair; the tail at the end.
+        const ValuePtr& rest() const {
+            return *current;
+        }
+    };
+
+    explicit ListView(const ValuePtr& list) : list{&list} {}
+
+    iterator begin() const {
+        return iterator(list);
+    }
+    std::default_sentinel_t end() const {
+        return std::default_sentinel;
+    }
+
+    bool empty() const {
+        return !(*list)->isType(ValueType::PAIR);
+    }
+    size_t size() const;
+    const ValuePtr& tail() const;
+    bool isProper() const {
+        return tail()->isType(ValueType::NIL);
+    }
 };
 
 
-class SymbolValue : public Value {
-    std::string value;
+/**ListBuilder class
+ * Builds a list front to back in linear time: each element is linked
+ * after the last pair, which the builder keeps track of.
+ */
+class ListBuilder {
+    ValuePtr head = ValuePtr::nil();
+    PairValue* last = nullptr;
 
 public:
-    SymbolValue(const std::string& value) : Value(ValueType::SYMBOL), value{value} {}
-
-    std::string toString() const override;
+    void push(ValuePtr value);
 
-    std::optional<std::string> asSymbol() const override;
+    // The list built so far, with tail as the cdr of its last pair; the
+    // builder is left empty.
+    ValuePtr finish(ValuePtr tail = ValuePtr::nil());
 };
 
+ValuePtr makeList(Arguments values);
 
-class PairValue : public Value {
-    ValuePtr car;
-    ValuePtr cdr;
+
+/**VectorValue class
+ * A fixed number of values stored contiguously and indexed in constant
+ * time. Elements can be replaced in place, so a vector can come to hold
+ * itself; it takes part in cycle collection like a frame.
+ */
+class VectorValue : public Value {
+    std::vector<ValuePtr> elements;
 
 public:
-    PairValue(ValuePtr car, ValuePtr cdr) : Value(ValueType::PAIR), car{car}, cdr{cdr} {}
-    PairValue(const std::vector<ValuePtr>& values);
+    VectorValue(std::vector<ValuePtr> elements) : Value(ValueType::VECTOR), elements{std::move(elements)} {}
 
     std::string toString() const override;
-    std::vector<ValuePtr> toVector() const override;
 
-    ValuePtr getCar() const;
-    ValuePtr getCdr() const;
+    std::vector<ValuePtr>& getElements() {
+        return elements;
+    }
+    const std::vector<ValuePtr>& getElements() const {
+        return elements;
+    }
+
+    void trace(std::vector<Collectable*>& children) const override;
+    void clearReferences() override;
 };
 
 
+// Whether two values are equal?: numbers by value, strings by contents,
+// pairs and vectors element by element and everything else by identity.
+bool equalValues(const ValuePtr& left, const ValuePtr& right);
+
+// A hash of a value that agrees with equalValues.
+size_t hashValue(const ValuePtr& value);
+
+
+/**BuiltinProcValue class
+ * A procedure written in C++. It has a generic entry taking any number of
+ * arguments in a vector, a direct entry for one fixed number of arguments
+ * read from contiguous handles, or both; see builtins::fixed. The
+ * evaluators use the direct entry whenever the argument count matches, so
+ * such calls build no argument vector.
+ */
 class BuiltinProcValue : public Value {
-    using BuiltinFuncType = ValuePtr(const std::vector<ValuePtr>&, EvalEnv&);
+public:
+    using BuiltinFuncType = ValuePtr(Arguments, EvalEnv&);
+    using FixedFuncType = ValuePtr(const BuiltinProcValue&, const ValuePtr*);
+
+    static constexpr size_t MAX_FIXED_ARITY = 3;
+
+private:
     BuiltinFuncType* func;
+    FixedFuncType* fixed = nullptr;
+    size_t arity = 0;
+    std::string_view name;
 
 public:
     BuiltinProcValue(BuiltinFuncType* func) : Value(ValueType::BUILTIN), func{func} {}
-
-    ValuePtr call(const std::vector<ValuePtr>& args, EvalEnv& env) const override;
+    BuiltinProcValue(std::string_view name, size_t arity, FixedFuncType* fixed, BuiltinFuncType* func) :
+        Value(ValueType::BUILTIN), func{func}, fixed{fixed}, arity{arity}, name{name} {}
+
+    // proc if it is a builtin with a direct entry for argc arguments.
+    static const BuiltinProcValue* withArity(const ValuePtr& proc, size_t argc) {
+        if (!proc->isType(ValueType::BUILTIN)) {
+            return nullptr;
+        }
+        auto builtin = static_cast<const BuiltinProcValue*>(proc.get());
+        return builtin->fixed && builtin->arity == argc ? builtin : nullptr;
+    }
+
+    std::string_view getName() const {
+        return name;
+    }
+    ValuePtr callFixed(const ValuePtr* args) const {
+        return fixed(*this, args);
+    }
+    ValuePtr call(Arguments args, EvalEnv& env) const override;
+
+    // Throws "<Name> requires <requirement>."
+    [[noreturn]] void fail(std::string_view requirement) const;
 
     std::string toString() const override;
 };
 
 class EvalEnv;
+
+/**LambdaValue class
+ * A closure of the tree-walking evaluator: the template shared by every
+ * closure of one lambda expression, and the values of just the variables
+ * its body takes from enclosing frames, in the order of its scope.
+ */
 class LambdaValue : public Value {
-    std::vector<std::string> params;
-    std::vector<ValuePtr> body;
-    std::shared_ptr<EvalEnv> env;
+    std::shared_ptr<const LambdaTemplate> code;
+    ValueVector captures;
 
 public:
-    LambdaValue(const std::vector<std::string>& params, 
-                const std::vector<ValuePtr>& body, 
-                std::shared_ptr<EvalEnv> env) : 
-        Value(ValueType::LAMBDA), params{params}, body{body}, env{env} {}
-
-    ValuePtr call(const std::vector<ValuePtr>& args, EvalEnv& env) const override;
+    LambdaValue(std::shared_ptr<const LambdaTemplate> code, ValueVector captures) :
+        Value(ValueType::LAMBDA), code{std::move(code)}, captures{std::move(captures)} {}
+
+    ValuePtr call(Arguments args, EvalEnv& env) const override;
+
+    const std::shared_ptr<const LambdaTemplate>& getTemplate() const {
+        return code;
+    }
+    const ValueVector& getCaptures() const {
+        return captures;
+    }
+    // Only for closures being restored from an image, which may capture
+    // each other and so are created before their captures.
+    void setCaptures(ValueVector values) {
+        captures = std::move(values);
+    }
+
+    void trace(std::vector<Collectable*>& children) const override;
+    void clearReferences() override;
 
     std::string toString() const override;
 };
 
+
+// A frame slot shared between closures: internal defines that a closure
+// captures are kept in one, so the closure sees them once they run.
+class BoxValue : public Value {
+public:
+    ValuePtr value;
+
+    BoxValue(ValuePtr value) : Value(ValueType::BOX), value{std::move(value)} {}
+
+    void trace(std::vector<Collectable*>& children) const override {
+        traceValue(value, children);
+    }
+    void clearReferences() override {
+        value = nullptr;
+    }
+};
+
 #endif
\ No newline at end of file
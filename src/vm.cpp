@@ -0,0 +1,268 @@
+#include <typeinfo>
+
+#include "./compiler.h"
+#include "./error.h"
+#include "./vm.h"
+
+/**ClosureValue class
+ * Methods for derived class ClosureValue
+ */
+ValuePtr ClosureValue::call(Arguments args, EvalEnv& env) const {
+    VM vm(env);
+    return vm.call(*this, args);
+}
+
+std::string ClosureValue::toString() const {
+    return "#<procedure>";
+}
+
+void ClosureValue::trace(std::vector<Collectable*>& children) const {
+    for (const auto& capture : captures) {
+        traceValue(capture, children);
+    }
+}
+
+void ClosureValue::clearReferences() {
+    captures.clear();
+}
+
+
+/**VM class
+ * Methods for the bytecode interpreter
+ */
+ValuePtr VM::eval(ValuePtr expr) {
+    auto closure = makeValue<ClosureValue>(Compiler::compileTopLevel(expr), std::vector<ValuePtr>{});
+    return call(static_cast<ClosureValue&>(*closure.get()), {});
+}
+
+ValuePtr VM::call(const ClosureValue& closure, Arguments args) {
+    stack.clear();
+    frames.clear();
+    stack.push_back(nullptr);   // the callee slot, owned by the caller here
+    stack.insert(stack.end(), args.begin(), args.end());
+    enter(closure, args.size());
+    return execute();
+}
+
+// Pushes a frame for `closure`, whose arguments are the top `argc` values.
+void VM::enter(const ClosureValue& closure, size_t argc) {
+    if (closure.proto->code.empty()) {
+        const auto& restored = *closure.proto;
+        if (!restored.compiled) {
+            restored.compiled = Compiler::compileRestored(restored);
+        }
+        closure.proto = restored.compiled;
+    }
+    if (closure.proto->numParams != argc) {
+        throw LispError("Parameter size and argument size do not match.");
+    }
+    size_t base = stack.size() - argc;
+    stack.resize(base + closure.proto->numSlots);
+    frames.push_back({&closure, closure.proto->code.data(), base});
+}
+
+ValuePtr VM::execute() {
+    CallFrame* frame = &frames.back();
+    const Prototype* proto = frame->closure->proto.get();
+    const uint8_t* ip = frame->ip;
+
+    auto nil = ValuePtr::nil();
+    auto pop = [this]() {
+        ValuePtr value = std::move(stack.back());
+        stack.pop_back();
+        return value;
+    };
+    auto unbound = [&](uint16_t name) {
+        return LispError("Variable " + proto->names[name].name() + " not defined.");
+    };
+
+    while (true) {
+        auto op = static_cast<OpCode>(*ip++);
+        switch (op) {
+
+        case OpCode::CONST:
+            stack.push_back(proto->constants[readU16(ip)]);
+            ip += 2;
+            break;
+
+        case OpCode::POP:
+            stack.pop_back();
+            break;
+
+        case OpCode::LOCAL_LOAD: {
+            ValuePtr value = stack[frame->base + readU16(ip)];
+            stack.push_back(std::move(value));
+            ip += 2;
+            break;
+        }
+
+        case OpCode::LOCAL_STORE:
+            stack[frame->base + readU16(ip)] = pop();
+            ip += 2;
+            break;
+
+        case OpCode::BOX_LOAD: {
+            auto& box = static_cast<BoxValue&>(*stack[frame->base + readU16(ip)].get());
+            if (!box.value) {
+                throw unbound(readU16(ip + 2));
+            }
+            stack.push_back(box.value);
+            ip += 4;
+            break;
+        }
+
+        case OpCode::BOX_STORE:
+            static_cast<BoxValue&>(*stack[frame->base + readU16(ip)].get()).value = pop();
+            ip += 2;
+            break;
+
+        case OpCode::MAKE_BOX:
+            stack[frame->base + readU16(ip)] = makeValue<BoxValue>(nullptr);
+            ip += 2;
+            break;
+
+        case OpCode::BOX: {
+            auto& slot = stack[frame->base + readU16(ip)];
+            slot = makeValue<BoxValue>(slot);
+            ip += 2;
+            break;
+        }
+
+        case OpCode::CAPTURE_LOAD:
+            stack.push_back(frame->closure->captures[readU16(ip)]);
+            ip += 2;
+            break;
+
+        case OpCode::CAPTURE_BOX_LOAD: {
+            auto& box = static_cast<BoxValue&>(*frame->closure->captures[readU16(ip)].get());
+            if (!box.value) {
+                throw unbound(readU16(ip + 2));
+            }
+            stack.push_back(box.value);
+            ip += 4;
+            break;
+        }
+
+        case OpCode::GLOBAL_LOAD:
+            stack.push_back(proto->globals[readU16(ip)].load(globals));
+            ip += 2;
+            break;
+
+        case OpCode::GLOBAL_DEFINE:
+            proto->globals[readU16(ip)].define(globals, pop());
+            stack.push_back(nil);
+            ip += 2;
+            break;
+
+        case OpCode::JUMP:
+            ip = proto->code.data() + readU32(ip);
+            break;
+
+        case OpCode::JUMP_IF_FALSE:
+            if (!pop()->asBoolean()) {
+                ip = proto->code.data() + readU32(ip);
+            } else {
+                ip += 4;
+            }
+            break;
+
+        case OpCode::JUMP_IF_FALSE_KEEP:
+            if (!stack.back()->asBoolean()) {
+                ip = proto->code.data() + readU32(ip);
+            } else {
+                stack.pop_back();
+                ip += 4;
+            }
+            break;
+
+        case OpCode::JUMP_IF_TRUE_KEEP:
+            if (stack.back()->asBoolean()) {
+                ip = proto->code.data() + readU32(ip);
+            } else {
+                stack.pop_back();
+                ip += 4;
+            }
+            break;
+
+        case OpCode::CALL:
+        case OpCode::TAIL_CALL: {
+            size_t argc = readU16(ip);
+            ip += 2;
+            size_t procIndex = stack.size() - argc - 1;
+            const Value* proc = stack[procIndex].get();
+
+            if (proc && typeid(*proc) == typeid(ClosureValue)) {
+                auto closure = static_cast<const ClosureValue*>(proc);
+                if (op == OpCode::TAIL_CALL) {
+                    // Slide the callee and its arguments over the running frame.
+                    std::move(stack.begin() + procIndex, stack.end(), stack.begin() + frame->base - 1);
+                    stack.resize(frame->base + argc);
+                    frames.pop_back();
+                } else {
+                    frame->ip = ip;
+                }
+                enter(*closure, argc);
+                frame = &frames.back();
+                proto = closure->proto.get();
+                ip = frame->ip;
+                break;
+            }
+
+            ValuePtr result;
+            if (auto builtin = BuiltinProcValue::withArity(stack[procIndex], argc)) {
+                // Its arguments are read where they lie on the stack.
+                result = builtin->callFixed(&stack[procIndex + 1]);
+            } else {
+                if (!proc || (!proc->isType(ValueType::BUILTIN) && !proc->isType(ValueType::LAMBDA))) {
+                    throw LispError("Unimplemented");
+                }
+                result = proc->call(Arguments(stack.data() + procIndex + 1, argc), globals);
+            }
+            stack.resize(procIndex);
+            stack.push_back(std::move(result));
+            if (op == OpCode::CALL) {
+                break;
+            }
+            [[fallthrough]];
+        }
+
+        case OpCode::RETURN: {
+            ValuePtr result = pop();
+            stack.resize(frame->base - 1);
+            frames.pop_back();
+            if (frames.empty()) {
+                return result;
+            }
+            stack.push_back(std::move(result));
+            frame = &frames.back();
+            proto = frame->closure->proto.get();
+            ip = frame->ip;
+            break;
+        }
+
+        case OpCode::CLOSURE: {
+            const auto& child = proto->prototypes[readU16(ip)];
+            ip += 2;
+            std::vector<ValuePtr> captures;
+            captures.reserve(child->captures.size());
+            for (const auto& capture : child->captures) {
+                captures.push_back(capture.fromLocal ?
+                    stack[frame->base + capture.index] :
+                    frame->closure->captures[capture.index]);
+            }
+            stack.push_back(makeValue<ClosureValue>(child, std::move(captures)));
+            break;
+        }
+
+        case OpCode::CONS: {
+            ValuePtr cdr = pop();
+            ValuePtr car = pop();
+            stack.push_back(makeValue<PairValue>(std::move(car), std::move(cdr)));
+            break;
+        }
+
+        case OpCode::FAIL:
+            throw LispError(proto->constants[readU16(ip)]->asString().value());
+        }
+    }
+}
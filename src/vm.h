@@ -0,0 +1,70 @@
+#ifndef VM_H
+#define VM_H
+
+#include <memory>
+#include <vector>
+
+#include "./bytecode.h"
+#include "./eval_env.h"
+#include "./value.h"
+
+class ClosureValue : public Value {
+    mutable PrototypePtr proto;     // replaced by its code once a restored one is called
+    std::vector<ValuePtr> captures;
+
+    friend class VM;
+
+public:
+    ClosureValue(PrototypePtr proto, std::vector<ValuePtr> captures) :
+        Value(ValueType::LAMBDA), proto{std::move(proto)}, captures{std::move(captures)} {}
+
+    ValuePtr call(Arguments args, EvalEnv& env) const override;
+
+    const PrototypePtr& getPrototype() const {
+        return proto;
+    }
+    const std::vector<ValuePtr>& getCaptures() const {
+        return captures;
+    }
+    // Only for closures being restored from an image, which may capture
+    // each other and so are created before their captures.
+    void setCaptures(std::vector<ValuePtr> values) {
+        captures = std::move(values);
+    }
+
+    std::string toString() const override;
+
+    void trace(std::vector<Collectable*>& children) const override;
+    void clearReferences() override;
+};
+
+
+/**VM class
+ * Executes compiled prototypes over one contiguous value stack. A frame
+ * owns the slots [base, base + numSlots) of the stack, right above the
+ * procedure being run; its operands are pushed on top of them. Globals
+ * and builtins are shared with the tree-walking evaluator through the
+ * EvalEnv the VM was created with.
+ */
+class VM {
+    struct CallFrame {
+        const ClosureValue* closure;
+        const uint8_t* ip;
+        size_t base;
+    };
+
+    EvalEnv& globals;
+    std::vector<ValuePtr> stack;
+    std::vector<CallFrame> frames;
+
+    void enter(const ClosureValue& closure, size_t argc);
+    ValuePtr execute();
+
+public:
+    VM(EvalEnv& globals) : globals{globals} {}
+
+    ValuePtr eval(ValuePtr expr);
+    ValuePtr call(const ClosureValue& closure, Arguments args);
+};
+
+#endif